@@ -7,17 +7,31 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsAtomic.h>
 
 #include <asynPortDriver.h>
 #define epicsExportSharedSymbols
 #include <shareLib.h>
 #include "asynMotorAxis.h"
 #include "asynMotorController.h"
+#include "asynMotorTime.h"
 
 static const char *driverName = "asynMotorAxis";
 
+static void autoPowerCallbackC(void *pPvt);
+
+static double getCurrentSecs()
+{
+  epicsTimeStamp nowTime;
+
+  epicsTimeGetCurrent(&nowTime);
+  return nowTime.secPastEpoch + (nowTime.nsec / 1.e9);
+}
+
 
 /** Creates a new asynMotorAxis object.
   * \param[in] pC Pointer to the asynMotorController to which this axis belongs. 
@@ -57,11 +71,48 @@ asynMotorAxis::asynMotorAxis(class asynMotorController *pC, int axisNo)
   disableFlag_ = 0;
   lastEndOfMoveTime_ = 0;
 
+  /* Used by the poller to schedule polls of this axis */
+  nextPollTime_ = 0;
+  forcedFastPolls_ = 0;
+  pollRequested_ = 0;
+  pollCount_ = 0;
+  predictedEndTime_ = 0;
+
+  /* Used for the auto power on and off delays */
+  autoPowerTimer_ = NULL;
+  autoPowerState_ = AUTO_POWER_IDLE;
+  autoPowerGeneration_ = 0;
+  autoPowerDueTime_ = 0;
+  pendingMoveFunction_ = -1;
+  pendingMoveValue_ = 0;
+
+  /* Used to publish the status to readers that do not take the lock */
+  statusSequence_ = 0;
+  memset(&sharedStatus_, 0, sizeof(sharedStatus_));
+  epicsTimeGetCurrent(&sharedStatusTime_);
+
+  /* Cached motion parameters */
+  memset(&motionParams_, 0, sizeof(motionParams_));
+
+  /* Used to limit status callbacks */
+  forceStatusCallback_ = 0;
+  memset(&publishedStatus_, 0, sizeof(publishedStatus_));
+  lastStatusCallbackTime_ = 0;
+  positionDeadband_ = 0;
+  encoderDeadband_ = 0;
+  velocityDeadband_ = 0;
+  maxStatusRate_ = 0;
+
   // Create the asynUser, connect to this axis
   pasynUser_ = pasynManager->createAsynUser(NULL, NULL);
   pasynManager->connectDevice(pasynUser_, pC->portName, axisNo);
   
   // Initialize some parameters
+  // The status parameters are only written when they change, so they need initial values
+  for (int bit=0; bit<MOTOR_STATUS_NUM_BITS; bit++) {
+    pC_->setIntegerParam(axisNo_, pC_->motorStatusDirection_ + bit, 0);
+  }
+  pC_->setIntegerParam(axisNo_, pC_->motorStatus_, 0);
   setIntegerParam(pC_->motorPowerAutoOnOff_, 0);
   setDoubleParam(pC_->motorPowerOffDelay_, 0.);
   setDoubleParam(pC_->motorPowerOnDelay_, 0.);
@@ -125,6 +176,29 @@ asynStatus asynMotorAxis::poll(bool *moving)
 }
 
 
+/** Updates the axis from the status that asynMotorController::poll() read for all axes.
+  * This is called by the poller instead of poll() when the controller uses a status snapshot
+  * (see asynMotorController::initializeStatusSnapshot()) and has marked the entry for this axis valid.
+  * It sets the position, encoder position, velocity and status bit parameters and calls
+  * callParamCallbacks(), as poll() does.  That sends the parameters that changed to their I/O Intr
+  * clients, and only does the devMotorAsyn status callback when the status changed by more than
+  * the deadbands.
+  * Derived classes can reimplement this to handle additional controller-specific information.
+  * \param[in] pSnapshot The status of this axis.
+  * \param[out] moving Set to true if the done bit in the status is not set. */
+asynStatus asynMotorAxis::setStatusSnapshot(MotorAxisSnapshot *pSnapshot, bool *moving)
+{
+  setDoubleParam(pC_->motorPosition_, pSnapshot->position);
+  setDoubleParam(pC_->motorEncoderPosition_, pSnapshot->encoderPosition);
+  setDoubleParam(pC_->motorActVelocity_, pSnapshot->velocity);
+  setStatusBits(MOTOR_STATUS_ALL_BITS, pSnapshot->status);
+
+  *moving = (status_.status & MOTOR_STATUS_DONE) ? false : true;
+  callParamCallbacks();
+  return asynSuccess;
+}
+
+
 /** Set the current position of the motor.
   * \param[in] position The new absolute motor position that should be set in the hardware. Units=steps.*/
 asynStatus asynMotorAxis::setPosition(double position)
@@ -217,6 +291,96 @@ asynStatus asynMotorAxis::doMoveToHome()
 }
 
 
+/** Starts the auto power timer.
+  * The timer runs on a timer queue shared by all controllers, so the port is not blocked during the delay.
+  * Must be called with the controller lock held.
+  * \param[in] state AUTO_POWER_ON_PENDING to start pendingMoveFunction_ when the timer expires,
+  *                  AUTO_POWER_OFF_PENDING to disable the drive.
+  * \param[in] delay The delay in seconds. */
+void asynMotorAxis::startAutoPowerTimer(int state, double delay)
+{
+  if (!pC_->autoPowerTimerQueue_)
+    pC_->autoPowerTimerQueue_ = epicsTimerQueueAllocate(1, epicsThreadPriorityMedium);
+  if (!autoPowerTimer_)
+    autoPowerTimer_ = epicsTimerQueueCreateTimer(pC_->autoPowerTimerQueue_, autoPowerCallbackC, this);
+  autoPowerState_ = state;
+  epicsAtomicIncrIntT(&autoPowerGeneration_);
+  autoPowerDueTime_ = getMonotonicSecs() + delay;
+  epicsTimerStartDelay(autoPowerTimer_, delay);
+}
+
+/** Cancels the auto power timer and any move waiting for it.
+  * Must be called with the controller lock held.  The timer itself is not cancelled, because
+  * epicsTimerCancel() waits for a running autoPowerCallback(), which may be waiting for the lock.
+  * If the timer still expires, autoPowerCallback() finds autoPowerState_ idle and does nothing. */
+void asynMotorAxis::cancelAutoPowerTimer()
+{
+  autoPowerState_ = AUTO_POWER_IDLE;
+  epicsAtomicIncrIntT(&autoPowerGeneration_);
+  pendingMoveFunction_ = -1;
+  disableFlag_ = 0;
+}
+
+static void autoPowerCallbackC(void *pPvt)
+{
+  asynMotorAxis *pAxis = (asynMotorAxis *)pPvt;
+  pAxis->autoPowerCallback();
+}
+
+/** Called from the timer queue thread when the auto power timer expires.
+  * Starts the move that was waiting for the power on delay, or disables the drive.
+  * A callback that started before the timer was last started or cancelled does nothing.
+  * If the timer expires early, which it may do by up to half a sleep quantum or after a
+  * wall clock step, it is restarted for the remaining delay. */
+void asynMotorAxis::autoPowerCallback()
+{
+  int function, generation;
+  double remaining;
+  asynStatus status;
+  static const char *functionName = "autoPowerCallback";
+
+  generation = epicsAtomicGetIntT(&autoPowerGeneration_);
+  pC_->lock();
+  // The timer may have been cancelled or restarted while this callback waited for the lock
+  if ((autoPowerState_ == AUTO_POWER_IDLE) || (generation != autoPowerGeneration_)) {
+    pC_->unlock();
+    return;
+  }
+  remaining = autoPowerDueTime_ - getMonotonicSecs();
+  if (remaining > epicsThreadSleepQuantum()/2.) {
+    epicsTimerStartDelay(autoPowerTimer_, remaining);
+    pC_->unlock();
+    return;
+  }
+  if (autoPowerState_ == AUTO_POWER_ON_PENDING) {
+    function = pendingMoveFunction_;
+    autoPowerState_ = AUTO_POWER_IDLE;
+    pendingMoveFunction_ = -1;
+    asynPrint(pasynUser_, ASYN_TRACE_FLOW,
+      "%s:%s: axis %d power on delay done, starting move\n",
+      driverName, functionName, axisNo_);
+    status = pC_->startMove(this, function, pendingMoveValue_);
+    if (status != asynSuccess) {
+      // The record was told the move started when it was queued, so report the failure in the status
+      asynPrint(pasynUser_, ASYN_TRACE_ERROR,
+        "%s:%s: axis %d error starting move after power on delay, status=%d\n",
+        driverName, functionName, axisNo_, status);
+      setStatusBits(MOTOR_STATUS_PROBLEM | MOTOR_STATUS_DONE, MOTOR_STATUS_PROBLEM | MOTOR_STATUS_DONE);
+      callParamCallbacks();
+    }
+  } else {
+    autoPowerState_ = AUTO_POWER_IDLE;
+    asynPrint(pasynUser_, ASYN_TRACE_FLOW,
+      "%s:%s: axis %d power off delay done, disabling drive\n",
+      driverName, functionName, axisNo_);
+    setClosedLoop(0);
+    disableFlag_ = 0;
+    callParamCallbacks();
+  }
+  pC_->unlock();
+}
+
+
 /**
  * Set method for referencingModeMove_
  */
@@ -249,50 +413,79 @@ int  asynMotorAxis::getReferencingModeMove()
   * \param[in] value Value to set */
 asynStatus asynMotorAxis::setIntegerParam(int function, int value)
 {
-  int mask;
-  epicsUInt32 status=0;
+  epicsUInt32 mask;
   // This assumes the parameters defined above are in the same order as the bits the motor record expects!
   if (function >= pC_->motorStatusDirection_ && 
       function <= pC_->motorStatusHomed_) {
-    status = status_.status;
     mask = 1 << (function - pC_->motorStatusDirection_);
-    if (value) status |= mask;
-    else       status &= ~mask;
-    if (status != status_.status) {
-      status_.status = status;
-      statusChanged_ = 1;
-    }
+    return setStatusBits(mask, value ? mask : 0);
   }
+  if (function == pC_->motorPowerAutoOnOff_) motionParams_.autoPower = value;
   // Call the base class method
-  pC_->setIntegerParam(axisNo_, pC_->motorStatus_, status);
   return pC_->setIntegerParam(axisNo_, function, value);
 }
 
+/** Sets several bits of the status of this axis at once.
+  * The bits in mask are set to the corresponding bits in values, and the others are left unchanged.
+  * Only the motorStatus parameters of the bits that change are written, motorStatus_ is written once,
+  * and if anything changed a flag is set to do callbacks to devMotorAsyn when callParamCallbacks() is called.
+  * This is more efficient than calling setIntegerParam() for each status parameter.
+  * \param[in] mask The bits to set, a combination of the MOTOR_STATUS_ bits.
+  * \param[in] values The new values of those bits. */
+asynStatus asynMotorAxis::setStatusBits(epicsUInt32 mask, epicsUInt32 values)
+{
+  epicsUInt32 status = (status_.status & ~mask) | (values & mask & MOTOR_STATUS_ALL_BITS);
+  epicsUInt32 changed = status ^ status_.status;
+  int bit;
+
+  if (!changed) return asynSuccess;
+  for (bit=0; bit<MOTOR_STATUS_NUM_BITS; bit++) {
+    if (changed & (1 << bit))
+      pC_->setIntegerParam(axisNo_, pC_->motorStatusDirection_ + bit, (status >> bit) & 1);
+  }
+  status_.status = status;
+  statusChanged_ = 1;
+  return pC_->setIntegerParam(axisNo_, pC_->motorStatus_, status);
+}
+
 
 
 /** Sets the value for a double for this axis in the parameter library.
-  * This function takes special action if the parameter is motorPosition_ or motorEncoderPosition_.  
-  * In that case it sets the value in the private MotorStatus structure and if the value has changed
+  * This function takes special action if the parameter is motorPosition_, motorEncoderPosition_
+  * or motorActVelocity_.  In that case it sets the value in the private MotorStatus structure and if
+  * the value differs from the one sent by the last status callback by more than the deadband
   * then sets a flag to do callbacks to devMotorAsyn when callParamCallbacks() is called.
   * \param[in] function The function (parameter) number 
   * \param[in] value Value to set */
 asynStatus asynMotorAxis::setDoubleParam(int function, double value)
 {
   if (function == pC_->motorPosition_) {
-    if (value != status_.position) {
-        statusChanged_ = 1;
-        status_.position = value;
-    }
+    status_.position = value;
+    if (fabs(value - publishedStatus_.position) > positionDeadband_) statusChanged_ = 1;
   } else if (function == pC_->motorEncoderPosition_) {
-    if (value != status_.encoderPosition) {
-        statusChanged_ = 1;
-        status_.encoderPosition = value;
-    }
+    status_.encoderPosition = value;
+    if (fabs(value - publishedStatus_.encoderPosition) > encoderDeadband_) statusChanged_ = 1;
   } else if (function == pC_->motorActVelocity_) {
-    if (value != status_.velocity) {
-        statusChanged_ = 1;
-        status_.velocity = value;
-    }
+    status_.velocity = value;
+    if (fabs(value - publishedStatus_.velocity) > velocityDeadband_) statusChanged_ = 1;
+  } else if (function == pC_->motorVelBase_) {
+    motionParams_.baseVelocity = value;
+  } else if (function == pC_->motorVelocity_) {
+    motionParams_.velocity = value;
+  } else if (function == pC_->motorAccel_) {
+    motionParams_.acceleration = value;
+  } else if (function == pC_->motorPowerOnDelay_) {
+    motionParams_.autoPowerOnDelay = value;
+  } else if (function == pC_->motorPowerOffDelay_) {
+    motionParams_.autoPowerOffDelay = value;
+  } else if (function == pC_->motorPositionDeadband_) {
+    positionDeadband_ = value;
+  } else if (function == pC_->motorEncoderDeadband_) {
+    encoderDeadband_ = value;
+  } else if (function == pC_->motorVelocityDeadband_) {
+    velocityDeadband_ = value;
+  } else if (function == pC_->motorMaxStatusRate_) {
+    maxStatusRate_ = value;
   }
   // Call the base class method
   return pC_->setDoubleParam(axisNo_, function, value);
@@ -312,16 +505,66 @@ asynStatus asynMotorAxis::setStringParam(int function, const char *value)
 
 /** Calls the callbacks for any parameters that have changed for this axis in the parameter library.
   * This function takes special action if the aggregate MotorStatus structure has changed.
-  * In that case it does callbacks on the asynGenericPointer interface, typically to devMotorAsyn. */  
+  * In that case it does callbacks on the asynGenericPointer interface, typically to devMotorAsyn.
+  * If maxStatusRate_ is set, callbacks for position and velocity changes are held back until 1/maxStatusRate_
+  * has passed since the last one, and are then done by a later call.  Changes of the status bits are always
+  * passed on immediately. */  
 asynStatus asynMotorAxis::callParamCallbacks()
 {
+  double now;
+
+  publishStatus();
   if (statusChanged_) {
-    statusChanged_ = 0;
-    pC_->doCallbacksGenericPointer((void *)&status_, pC_->motorStatus_, axisNo_);
+    now = getCurrentSecs();
+    if (forceStatusCallback_ || (status_.status != publishedStatus_.status) || (maxStatusRate_ <= 0.) ||
+        (now - lastStatusCallbackTime_ >= 1./maxStatusRate_)) {
+      statusChanged_ = 0;
+      forceStatusCallback_ = 0;
+      publishedStatus_ = status_;
+      lastStatusCallbackTime_ = now;
+      pC_->doCallbacksGenericPointer((void *)&status_, pC_->motorStatus_, axisNo_);
+    }
   }
   return pC_->callParamCallbacks(axisNo_);
 }
 
+/** Copies status_ to the copy that readStatusSnapshot() reads without the lock.
+  * This uses a sequence count that is odd while the copy is being written (a seqlock).
+  * Must be called with the controller lock held, which serializes the writers. */
+void asynMotorAxis::publishStatus()
+{
+  epicsAtomicIncrIntT(&statusSequence_);
+  epicsAtomicWriteMemoryBarrier();
+  sharedStatus_ = status_;
+  epicsTimeGetCurrent(&sharedStatusTime_);
+  epicsAtomicWriteMemoryBarrier();
+  epicsAtomicIncrIntT(&statusSequence_);
+}
+
+/** Reads the status of the axis without taking the controller lock.
+  * Returns the status as of the last poll or callParamCallbacks().  If the poller is writing it
+  * at the same moment the read is retried, so the result is always consistent.
+  * \param[out] pStatus The status.
+  * \param[out] pTimeStamp The time the status was last updated. */
+void asynMotorAxis::readStatusSnapshot(MotorStatus *pStatus, epicsTimeStamp *pTimeStamp)
+{
+  int sequence;
+
+  while (1) {
+    sequence = epicsAtomicGetIntT(&statusSequence_);
+    if (sequence & 1) {
+      // A write is in progress
+      epicsThreadSleep(0.);
+      continue;
+    }
+    epicsAtomicReadMemoryBarrier();
+    *pStatus = sharedStatus_;
+    *pTimeStamp = sharedStatusTime_;
+    epicsAtomicReadMemoryBarrier();
+    if (epicsAtomicGetIntT(&statusSequence_) == sequence) break;
+  }
+}
+
 /* These are the functions for profile moves */
 asynStatus asynMotorAxis::initializeProfile(size_t maxProfilePoints)
 {
@@ -506,6 +749,14 @@ void asynMotorAxis::setLastEndOfMoveTime(double time)
   lastEndOfMoveTime_ = time;
 }
 
+/**
+ * Read the number of times the base class poller has polled this axis.
+ */
+unsigned long asynMotorAxis::getPollCount(void)
+{
+  return pollCount_;
+}
+
 
 /********************************************************************/
 
@@ -9,6 +9,7 @@
 #define asynMotorAxis_H
 
 #include <epicsEvent.h>
+#include <epicsTimer.h>
 #include <epicsTypes.h>
 #include <shareLib.h>
 
@@ -17,6 +18,25 @@
 
 #include "asynMotorController.h"
 
+/** States of the auto power on/off timer of an axis */
+enum AutoPowerState {
+  AUTO_POWER_IDLE,          /**< The timer is not running */
+  AUTO_POWER_ON_PENDING,    /**< The drive has been enabled and a move starts when the timer expires */
+  AUTO_POWER_OFF_PENDING    /**< A move has ended and the drive is disabled when the timer expires */
+};
+
+/** Copies of the parameters that are read on every move and every poll of an axis.
+  * They are kept up to date by asynMotorAxis::setIntegerParam() and asynMotorAxis::setDoubleParam(),
+  * so those paths do not need to search the parameter library. */
+typedef struct MotorAxisMotionParams {
+  double baseVelocity;       /**< motorVelBase_ */
+  double velocity;           /**< motorVelocity_ */
+  double acceleration;       /**< motorAccel_ */
+  int autoPower;             /**< motorPowerAutoOnOff_ */
+  double autoPowerOnDelay;   /**< motorPowerOnDelay_ */
+  double autoPowerOffDelay;  /**< motorPowerOffDelay_ */
+} MotorAxisMotionParams;
+
 /** Class from which motor axis objects are derived. */
 class epicsShareClass asynMotorAxis {
 
@@ -26,6 +46,7 @@ class epicsShareClass asynMotorAxis {
   virtual ~asynMotorAxis();
 
   virtual asynStatus setIntegerParam(int index, int value);
+  asynStatus setStatusBits(epicsUInt32 mask, epicsUInt32 values);
   virtual asynStatus setDoubleParam(int index, double value);
   virtual asynStatus setStringParam(int index, const char *value);
   virtual void report(FILE *fp, int details);
@@ -36,6 +57,7 @@ class epicsShareClass asynMotorAxis {
   virtual asynStatus home(double minVelocity, double maxVelocity, double acceleration, int forwards);
   virtual asynStatus stop(double acceleration);
   virtual asynStatus poll(bool *moving);
+  virtual asynStatus setStatusSnapshot(MotorAxisSnapshot *pSnapshot, bool *moving);
   virtual asynStatus setPosition(double position);
   virtual asynStatus setEncoderPosition(double position);
   virtual asynStatus setHighLimit(double highLimit);
@@ -65,6 +87,9 @@ class epicsShareClass asynMotorAxis {
   void setDisableFlag(int disableFlag);
   double getLastEndOfMoveTime();
   void setLastEndOfMoveTime(double time);
+  unsigned long getPollCount();
+  void autoPowerCallback();  // This should be private but is called from C function
+  void readStatusSnapshot(MotorStatus *pStatus, epicsTimeStamp *pTimeStamp);
 
   protected:
   class asynMotorController *pC_;    /**< Pointer to the asynMotorController to which this axis belongs.
@@ -78,12 +103,38 @@ class epicsShareClass asynMotorAxis {
 
   MotorStatus status_;
   int statusChanged_;
+  int forceStatusCallback_;           /**< Do the next status callback even if the rate limit has not expired */
 
   private:
   int referencingModeMove_;
   int wasMovingFlag_;
   int disableFlag_;
   double lastEndOfMoveTime_;
+  double nextPollTime_;       /**< Monotonic time (in secs) at which the poller next polls this axis in adaptive mode */
+  int forcedFastPolls_;       /**< Number of forced fast polls remaining for this axis */
+  int pollRequested_;         /**< Set when a command on this axis wakes up the poller */
+  unsigned long pollCount_;   /**< Number of times the poller has called poll() for this axis */
+  double predictedEndTime_;   /**< Monotonic time (in secs) at which the current move is predicted to end, 0 if unknown */
+  epicsTimerId autoPowerTimer_;  /**< Timer for the auto power on and off delays, created when first needed */
+  int autoPowerState_;        /**< What happens when autoPowerTimer_ expires, one of the AutoPowerState values */
+  int autoPowerGeneration_;   /**< Incremented each time autoPowerTimer_ is started or cancelled */
+  double autoPowerDueTime_;   /**< Monotonic time (in secs) at which autoPowerTimer_ is due to expire */
+  int pendingMoveFunction_;   /**< Move command waiting for the power on delay, -1 if none */
+  double pendingMoveValue_;   /**< Value of the pending move command */
+  int statusSequence_;        /**< Sequence count for sharedStatus_, odd while it is being written */
+  MotorStatus sharedStatus_;  /**< Copy of status_ that can be read without the lock, see readStatusSnapshot() */
+  epicsTimeStamp sharedStatusTime_;  /**< Time sharedStatus_ was last written */
+  MotorAxisMotionParams motionParams_;  /**< Cached copies of the motion parameters */
+  MotorStatus publishedStatus_;  /**< The status sent by the last status callback */
+  double lastStatusCallbackTime_;  /**< Time (in secs) of the last status callback */
+  double positionDeadband_;   /**< Position changes smaller than this do not cause a status callback */
+  double encoderDeadband_;    /**< Encoder position changes smaller than this do not cause a status callback */
+  double velocityDeadband_;   /**< Velocity changes smaller than this do not cause a status callback */
+  double maxStatusRate_;      /**< Maximum rate of status callbacks without status bit changes, 0 for no limit */
+
+  void startAutoPowerTimer(int state, double delay);
+  void cancelAutoPowerTimer();
+  void publishStatus();
   
   friend class asynMotorController;
 };
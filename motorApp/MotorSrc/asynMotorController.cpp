@@ -7,6 +7,8 @@
  */
 #include <stdlib.h>
 #include <string.h>
+#include <float.h>
+#include <math.h>
 
 #include <epicsThread.h>
 #include <iocsh.h>
@@ -18,6 +20,8 @@
 #include <shareLib.h>
 #include "asynMotorController.h"
 #include "asynMotorAxis.h"
+#include "asynMotorPollerPool.h"
+#include "asynMotorTime.h"
 
 #ifndef VERSION_INT
 #  define VERSION_INT(V,R,M,P) ( ((V)<<24) | ((R)<<16) | ((M)<<8) | (P))
@@ -27,10 +31,61 @@
 
 #define VERSION_INT_4_32 VERSION_INT(4,32,0,0)
 
+/* Shortest time the poller waits when an axis is already due for polling */
+#define MIN_POLL_WAIT 0.001
+
+/* Longest interval between the polls of a cruising axis with predictive polling, in moving poll periods */
+#define MAX_CRUISE_POLL_FACTOR 5.
+
 static const char *driverName = "asynMotorController";
 static void asynMotorPollerC(void *drvPvt);
 static void asynMotorMoveToHomeC(void *drvPvt);
+static void asynMotorPushReceiverC(void *drvPvt);
+
+/* Upper edges of the poller histogram bins in seconds, the last bin has no upper edge */
+static const double pollHistogramEdges[MOTOR_POLL_HIST_BINS-1] =
+  {0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1.0};
+
+/** Returns the current time in seconds, in the form used by the poller for its schedules. */
+static double getCurrentSecs()
+{
+  epicsTimeStamp nowTime;
+
+  epicsTimeGetCurrent(&nowTime);
+  return nowTime.secPastEpoch + (nowTime.nsec / 1.e9);
+}
+
+static void clearPollHistogram(MotorPollHistogram *pHist)
+{
+  memset(pHist, 0, sizeof(MotorPollHistogram));
+}
 
+static void addPollHistogram(MotorPollHistogram *pHist, double value)
+{
+  int bin;
+
+  for (bin=0; bin<MOTOR_POLL_HIST_BINS-1; bin++) {
+    if (value <= pollHistogramEdges[bin]) break;
+  }
+  pHist->counts[bin]++;
+  if ((pHist->num == 0) || (value < pHist->min)) pHist->min = value;
+  if (value > pHist->max) pHist->max = value;
+  pHist->sum += value;
+  pHist->num++;
+}
+
+static void reportPollHistogram(FILE *fp, const char *name, MotorPollHistogram *pHist)
+{
+  int bin;
+
+  fprintf(fp, "  %s: samples=%lu, min=%f, max=%f, mean=%f\n", name, pHist->num,
+    pHist->min, pHist->max, pHist->num ? pHist->sum/pHist->num : 0.);
+  fprintf(fp, "   ");
+  for (bin=0; bin<MOTOR_POLL_HIST_BINS-1; bin++) {
+    fprintf(fp, " <=%gms:%d", pollHistogramEdges[bin]*1000., pHist->counts[bin]);
+  }
+  fprintf(fp, " >%gms:%d\n", pollHistogramEdges[MOTOR_POLL_HIST_BINS-2]*1000., pHist->counts[MOTOR_POLL_HIST_BINS-1]);
+}
 
 
 /** Creates a new asynMotorController object.
@@ -43,8 +98,8 @@ asynMotorController::asynMotorController(const char *portName, int numAxes, int
                                          int asynFlags, int autoConnect, int priority, int stackSize)
 
   : asynPortDriver(portName, numAxes,
-      interfaceMask | asynOctetMask | asynInt32Mask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask | asynDrvUserMask,
-      interruptMask | asynOctetMask | asynInt32Mask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask,
+      interfaceMask | asynOctetMask | asynInt32Mask | asynFloat64Mask | asynInt32ArrayMask | asynFloat64ArrayMask | asynGenericPointerMask | asynDrvUserMask,
+      interruptMask | asynOctetMask | asynInt32Mask | asynFloat64Mask | asynInt32ArrayMask | asynFloat64ArrayMask | asynGenericPointerMask,
       asynFlags, autoConnect, priority, stackSize),
     shuttingDown_(0), numAxes_(numAxes)
 {
@@ -79,6 +134,7 @@ asynMotorController::asynMotorController(const char *portName, int numAxes, int
   createParam(motorPostMoveDelayString,          asynParamFloat64,    &motorPostMoveDelay_);
   createParam(motorStatusString,                 asynParamInt32,      &motorStatus_);
   createParam(motorUpdateStatusString,           asynParamInt32,      &motorUpdateStatus_);
+  createParam(motorMoveCompoundString,   asynParamGenericPointer,      &motorMoveCompound_);
   createParam(motorStatusDirectionString,        asynParamInt32,      &motorStatusDirection_);
   createParam(motorStatusDoneString,             asynParamInt32,      &motorStatusDone_);
   createParam(motorStatusHighLimitString,        asynParamInt32,      &motorStatusHighLimit_);
@@ -100,6 +156,12 @@ asynMotorController::asynMotorController(const char *portName, int numAxes, int
   createParam(motorRecDirectionString,           asynParamInt32,      &motorRecDirection_);
   createParam(motorRecOffsetString,            asynParamFloat64,      &motorRecOffset_);
 
+  // These are per-axis parameters that limit the status callbacks to device support
+  createParam(motorPositionDeadbandString,     asynParamFloat64,      &motorPositionDeadband_);
+  createParam(motorEncoderDeadbandString,      asynParamFloat64,      &motorEncoderDeadband_);
+  createParam(motorVelocityDeadbandString,     asynParamFloat64,      &motorVelocityDeadband_);
+  createParam(motorMaxStatusRateString,        asynParamFloat64,      &motorMaxStatusRate_);
+
   // These are the per-controller parameters for profile moves
   createParam(profileNumAxesString,              asynParamInt32,      &profileNumAxes_);
   createParam(profileNumPointsString,            asynParamInt32,      &profileNumPoints_);
@@ -142,6 +204,24 @@ asynMotorController::asynMotorController(const char *portName, int numAxes, int
   createParam(PCOPulseWidthString,             asynParamFloat64,      &PCOPulseWidth_);
   createParam(PCOEnableString,                   asynParamInt32,      &PCOEnable_);
 
+  // These are the per-controller parameters for poller diagnostics
+  createParam(motorPollMaxLockWaitString,      asynParamFloat64,      &motorPollMaxLockWait_);
+  createParam(motorPollMaxLockHoldString,      asynParamFloat64,      &motorPollMaxLockHold_);
+  createParam(motorPollCycleHistString,     asynParamInt32Array,      &motorPollCycleHist_);
+  createParam(motorPollCycleMinString,         asynParamFloat64,      &motorPollCycleMin_);
+  createParam(motorPollCycleMaxString,         asynParamFloat64,      &motorPollCycleMax_);
+  createParam(motorPollCycleMeanString,        asynParamFloat64,      &motorPollCycleMean_);
+  createParam(motorPollLatenessHistString,  asynParamInt32Array,      &motorPollLatenessHist_);
+  createParam(motorPollLatenessMinString,      asynParamFloat64,      &motorPollLatenessMin_);
+  createParam(motorPollLatenessMaxString,      asynParamFloat64,      &motorPollLatenessMax_);
+  createParam(motorPollLatenessMeanString,     asynParamFloat64,      &motorPollLatenessMean_);
+  createParam(motorPollAxisHistString,      asynParamInt32Array,      &motorPollAxisHist_);
+  createParam(motorPollAxisMinString,          asynParamFloat64,      &motorPollAxisMin_);
+  createParam(motorPollAxisMaxString,          asynParamFloat64,      &motorPollAxisMax_);
+  createParam(motorPollAxisMeanString,         asynParamFloat64,      &motorPollAxisMean_);
+  createParam(motorPollEarlyWakeupsString,       asynParamInt32,      &motorPollEarlyWakeups_);
+  createParam(motorPollStatsResetString,         asynParamInt32,      &motorPollStatsReset_);
+
   pAxes_ = (asynMotorAxis**) calloc(numAxes, sizeof(asynMotorAxis*));
   pollEventId_ = epicsEventMustCreate(epicsEventEmpty);
   moveToHomeId_ = epicsEventMustCreate(epicsEventEmpty);
@@ -151,6 +231,27 @@ asynMotorController::asynMotorController(const char *portName, int numAxes, int
   setIntegerParam(profileExecuteState_, PROFILE_EXECUTE_DONE);
 
   moveToHomeAxis_ = 0;
+  movingPollPeriod_ = 0.;
+  idlePollPeriod_ = 0.;
+  forcedFastPolls_ = 0;
+  fastPollsLeft_ = 0;
+  pPollerPoolEntry_ = NULL;
+  pStatusSnapshot_ = NULL;
+  autoPowerTimerQueue_ = NULL;
+  pushHealthy_ = 0;
+  pushWatchdogPeriod_ = 0.;
+  pushMessages_ = 0;
+  pushErrors_ = 0;
+  adaptivePolling_ = 0;
+  predictivePolling_ = 0;
+  pollerReleaseLock_ = 0;
+  maxCommandWait_ = 0.;
+  maxPollLockHold_ = 0.;
+  setDoubleParam(motorPollMaxLockWait_, 0.);
+  setDoubleParam(motorPollMaxLockHold_, 0.);
+  expectedPollTime_ = 0.;
+  lastPollStatsTime_ = 0.;
+  resetPollStatistics();
 
   asynPrint(this->pasynUserSelf, ASYN_TRACE_FLOW,
     "%s:%s: constructor complete\n",
@@ -164,6 +265,7 @@ asynMotorController::~asynMotorController()
 /** Called when asyn clients call pasynManager->report().
   * This calls the report method for each axis, and then the base class
   * asynPortDriver report method.
+  * If level >= 1 it also prints the poller settings and the number of polls of each axis.
   * \param[in] fp FILE pointer.
   * \param[in] level Level of detail to print. */
 void asynMotorController::report(FILE *fp, int level)
@@ -171,9 +273,28 @@ void asynMotorController::report(FILE *fp, int level)
   int axis;
   asynMotorAxis *pAxis;
 
+  if (level >= 1) {
+    fprintf(fp, "Motor controller %s, moving poll period=%f, idle poll period=%f, adaptive polling=%d, predictive polling=%d\n",
+      portName, movingPollPeriod_, idlePollPeriod_, adaptivePolling_, predictivePolling_);
+    fprintf(fp, "  poller releases lock between axes=%d, max command wait=%f, max poller lock hold=%f\n",
+      pollerReleaseLock_, maxCommandWait_, maxPollLockHold_);
+    if (pPollerPoolEntry_) asynMotorPollerPool::getPool()->report(fp, level);
+    if (pushWatchdogPeriod_ > 0.)
+      fprintf(fp, "  push healthy=%d, watchdog period=%f, messages=%lu, errors=%lu\n",
+        pushHealthy_, pushWatchdogPeriod_, pushMessages_, pushErrors_);
+  }
+  if (level >= 2) {
+    fprintf(fp, "  early wakeups=%d\n", pollEarlyWakeups_);
+    reportPollHistogram(fp, "poll cycle time", &pollCycleHist_);
+    reportPollHistogram(fp, "poll start lateness", &pollLatenessHist_);
+    reportPollHistogram(fp, "axis poll time (all axes)", &pollAxisHist_);
+  }
   for (axis=0; axis<numAxes_; axis++) {
     pAxis = getAxis(axis);
     if (!pAxis) continue; 
+    if (level >= 1) {
+      fprintf(fp, "  axis %d: polls=%lu\n", axis, pAxis->getPollCount());
+    }
     pAxis->report(fp, level);
   }
 
@@ -181,6 +302,23 @@ void asynMotorController::report(FILE *fp, int level)
   asynPortDriver::report(fp, level);
 }
 
+/** Records how long a move or stop command waited between being queued and its write starting.
+  * devMotorAsyn sets pasynUser->timestamp when it queues the request, so this includes the wait
+  * for the port lock and for other requests queued before it.  Requests without a timestamp are
+  * not counted.  Called with the lock held, which protects *pMaxWait.
+  * \param[in] pasynUser asynUser structure of the request.
+  * \param[in,out] pMaxWait The longest wait so far. */
+static void updateMaxCommandWait(asynUser *pasynUser, double *pMaxWait)
+{
+  epicsTimeStamp now;
+  double waitTime;
+
+  if ((pasynUser->timestamp.secPastEpoch == 0) && (pasynUser->timestamp.nsec == 0)) return;
+  epicsTimeGetCurrent(&now);
+  waitTime = epicsTimeDiffInSeconds(&now, &pasynUser->timestamp);
+  if (waitTime > *pMaxWait) *pMaxWait = waitTime;
+}
+
 
 /** Called when asyn clients call pasynInt32->write().
   * Extracts the function and axis number from pasynUser.
@@ -210,7 +348,16 @@ asynStatus asynMotorController::writeInt32(asynUser *pasynUser, epicsInt32 value
 
   if (function == motorStop_) {
     double accel;
-    getDoubleParam(axis, motorAccel_, &accel);
+    updateMaxCommandWait(pasynUser, &maxCommandWait_);
+    if (pAxis->pendingMoveFunction_ >= 0) {
+      // Cancel a move that is waiting for the auto power on delay.  The poller then sees the
+      // end of the move and starts the auto power off delay.
+      pAxis->cancelAutoPowerTimer();
+      pAxis->setStatusBits(MOTOR_STATUS_DONE, MOTOR_STATUS_DONE);
+      pAxis->pollRequested_ = 1;
+      wakeupPoller();
+    }
+    accel = pAxis->motionParams_.acceleration;
     status = pAxis->stop(accel);
   
   } else if (function == motorDeferMoves_) {
@@ -225,6 +372,7 @@ asynStatus asynMotorController::writeInt32(asynUser *pasynUser, epicsInt32 value
     poll();
     status = pAxis->poll(&moving);
     pAxis->statusChanged_ = 1;
+    pAxis->forceStatusCallback_ = 1;
 
   } else if (function == profileBuild_) {
     status = buildProfile();
@@ -247,6 +395,9 @@ asynStatus asynMotorController::writeInt32(asynUser *pasynUser, epicsInt32 value
     }
   } else if (function == PCOEnable_) {
     status = pAxis->enablePCO(value);
+
+  } else if (function == motorPollStatsReset_) {
+    resetPollStatistics();
   }
 
   /* Do callbacks so higher layers see any changes */
@@ -276,10 +427,8 @@ asynStatus asynMotorController::writeInt32(asynUser *pasynUser, epicsInt32 value
 asynStatus asynMotorController::writeFloat64(asynUser *pasynUser, epicsFloat64 value)
 {
   int function = pasynUser->reason;
-  double baseVelocity, velocity, acceleration;
   asynMotorAxis *pAxis;
   int axis;
-  int forwards;
   int autoPower = 0;
   double autoPowerOnDelay = 0.0;
   asynStatus status = asynError;
@@ -289,80 +438,36 @@ asynStatus asynMotorController::writeFloat64(asynUser *pasynUser, epicsFloat64 v
   if (!pAxis) return asynError;
   axis = pAxis->axisNo_;
 
-  getIntegerParam(axis, motorPowerAutoOnOff_, &autoPower);
-  getDoubleParam(axis, motorPowerOnDelay_, &autoPowerOnDelay);
+  autoPower = pAxis->motionParams_.autoPower;
+  autoPowerOnDelay = pAxis->motionParams_.autoPowerOnDelay;
 
   /* Set the parameter and readback in the parameter library. */
   status = pAxis->setDoubleParam(function, value);
 
-  if (function == motorMoveRel_) {
-    if (autoPower == 1) {
-      status = pAxis->setClosedLoop(true);
-      pAxis->setWasMovingFlag(1);
-      epicsThreadSleep(autoPowerOnDelay);
-    }
-    getDoubleParam(axis, motorVelBase_, &baseVelocity);
-    getDoubleParam(axis, motorVelocity_, &velocity);
-    getDoubleParam(axis, motorAccel_, &acceleration);
-    status = pAxis->move(value, 1, baseVelocity, velocity, acceleration);
-    pAxis->setIntegerParam(motorStatusDone_, 0);
-    pAxis->callParamCallbacks();
-    wakeupPoller();
-    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
-      "%s:%s: Set driver %s, axis %d move relative by %f, base velocity=%f, velocity=%f, acceleration=%f\n",
-      driverName, functionName, portName, pAxis->axisNo_, value, baseVelocity, velocity, acceleration );
-  
-  } else if (function == motorMoveAbs_) {
-    if (autoPower == 1) {
-      status = pAxis->setClosedLoop(true);
-      pAxis->setWasMovingFlag(1);
-      epicsThreadSleep(autoPowerOnDelay);
-    }
-    getDoubleParam(axis, motorVelBase_, &baseVelocity);
-    getDoubleParam(axis, motorVelocity_, &velocity);
-    getDoubleParam(axis, motorAccel_, &acceleration);
-    status = pAxis->move(value, 0, baseVelocity, velocity, acceleration);
-    pAxis->setIntegerParam(motorStatusDone_, 0);
-    pAxis->callParamCallbacks();
-    wakeupPoller();
-    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
-      "%s:%s: Set driver %s, axis %d move absolute to %f, base velocity=%f, velocity=%f, acceleration=%f\n",
-      driverName, functionName, portName, pAxis->axisNo_, value, baseVelocity, velocity, acceleration );
-
-  } else if (function == motorMoveVel_) {
+  if ((function == motorMoveRel_) || (function == motorMoveAbs_) ||
+      (function == motorMoveVel_)  || (function == motorHome_)) {
+    updateMaxCommandWait(pasynUser, &maxCommandWait_);
     if (autoPower == 1) {
+      // The drive is still enabled if the power off delay of the last move has not expired
+      if (pAxis->autoPowerState_ == AUTO_POWER_OFF_PENDING) autoPowerOnDelay = 0.;
+      pAxis->cancelAutoPowerTimer();
       status = pAxis->setClosedLoop(true);
       pAxis->setWasMovingFlag(1);
-      epicsThreadSleep(autoPowerOnDelay);
     }
-    getDoubleParam(axis, motorVelBase_, &baseVelocity);
-    getDoubleParam(axis, motorAccel_, &acceleration);
-    status = pAxis->moveVelocity(baseVelocity, value, acceleration);
-    pAxis->setIntegerParam(motorStatusDone_, 0);
-    pAxis->callParamCallbacks();
-    wakeupPoller();
-    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
-      "%s:%s: Set port %s, axis %d move with velocity of %f, acceleration=%f\n",
-      driverName, functionName, portName, pAxis->axisNo_, value, acceleration);
-
-  // Note, the motorHome command happens on the asynFloat64 interface, even though the value (direction) is really integer 
-  } else if (function == motorHome_) {
-    if (autoPower == 1) {
-      status = pAxis->setClosedLoop(true);
-      pAxis->setWasMovingFlag(1);
-      epicsThreadSleep(autoPowerOnDelay);
+    if ((autoPower == 1) && (autoPowerOnDelay > 0.)) {
+      /* Start the move when the power on delay expires, so the port is not blocked meanwhile.
+       * The poller does not poll the axis until then, so it stays not done. */
+      pAxis->pendingMoveFunction_ = function;
+      pAxis->pendingMoveValue_ = value;
+      pAxis->startAutoPowerTimer(AUTO_POWER_ON_PENDING, autoPowerOnDelay);
+      pAxis->setStatusBits(MOTOR_STATUS_DONE, 0);
+      pAxis->callParamCallbacks();
+      asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+        "%s:%s: Set driver %s, axis %d move delayed by %f for auto power on\n",
+        driverName, functionName, portName, pAxis->axisNo_, autoPowerOnDelay);
+    } else {
+      status = startMove(pAxis, function, value);
     }
-    getDoubleParam(axis, motorVelBase_, &baseVelocity);
-    getDoubleParam(axis, motorVelocity_, &velocity);
-    getDoubleParam(axis, motorAccel_, &acceleration);
-    forwards = (value == 0) ? 0 : 1;
-    status = pAxis->home(baseVelocity, velocity, acceleration, forwards);
-    pAxis->setIntegerParam(motorStatusDone_, 0);
-    pAxis->callParamCallbacks();
-    wakeupPoller();
-    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
-      "%s:%s: Set driver %s, axis %d to home %s, base velocity=%f, velocity=%f, acceleration=%f\n",
-      driverName, functionName, portName, pAxis->axisNo_, (forwards?"FORWARDS":"REVERSE"), baseVelocity, velocity, acceleration);
 
   } else if (function == motorPosition_) {
     status = pAxis->setPosition(value);
@@ -420,6 +525,17 @@ asynStatus asynMotorController::writeFloat64(asynUser *pasynUser, epicsFloat64 v
       "%s:%s: Set driver %s, axis %d encoder ratio=%f\n",
       driverName, functionName, portName, pAxis->axisNo_, value);
 
+  } else if ((function == motorPollMaxLockWait_) || (function == motorPollMaxLockHold_)) {
+    /* Writing either of these resets the lock statistics */
+    maxCommandWait_ = 0.;
+    maxPollLockHold_ = 0.;
+    setDoubleParam(motorPollMaxLockWait_, 0.);
+    setDoubleParam(motorPollMaxLockHold_, 0.);
+    callParamCallbacks();
+    asynPrint(pasynUser, ASYN_TRACE_FLOW, 
+      "%s:%s: Reset lock statistics for driver %s\n",
+      driverName, functionName, portName);
+
   }
   /* Do callbacks so higher layers see any changes */
   pAxis->callParamCallbacks();
@@ -436,6 +552,63 @@ asynStatus asynMotorController::writeFloat64(asynUser *pasynUser, epicsFloat64 v
     
 }
 
+/** Starts a move, jog or home of an axis.
+  * This is called by writeFloat64(), or by the auto power timer when the power on delay has expired.
+  * Must be called with the lock held.
+  * \param[in] pAxis The axis to move.
+  * \param[in] function motorMoveRel_, motorMoveAbs_, motorMoveVel_ or motorHome_.
+  * \param[in] value The value written to function. */
+asynStatus asynMotorController::startMove(asynMotorAxis *pAxis, int function, double value)
+{
+  double baseVelocity, velocity, acceleration;
+  double position;
+  int axis = pAxis->axisNo_;
+  int forwards;
+  asynStatus status = asynError;
+  static const char *functionName = "startMove";
+
+  baseVelocity = pAxis->motionParams_.baseVelocity;
+  velocity = pAxis->motionParams_.velocity;
+  acceleration = pAxis->motionParams_.acceleration;
+
+  if (function == motorMoveRel_) {
+    predictMoveEnd(pAxis, fabs(value), baseVelocity, velocity, acceleration);
+    status = pAxis->move(value, 1, baseVelocity, velocity, acceleration);
+    asynPrint(pAxis->pasynUser_, ASYN_TRACE_FLOW, 
+      "%s:%s: Set driver %s, axis %d move relative by %f, base velocity=%f, velocity=%f, acceleration=%f\n",
+      driverName, functionName, portName, axis, value, baseVelocity, velocity, acceleration );
+  
+  } else if (function == motorMoveAbs_) {
+    getDoubleParam(axis, motorPosition_, &position);
+    predictMoveEnd(pAxis, fabs(value - position), baseVelocity, velocity, acceleration);
+    status = pAxis->move(value, 0, baseVelocity, velocity, acceleration);
+    asynPrint(pAxis->pasynUser_, ASYN_TRACE_FLOW, 
+      "%s:%s: Set driver %s, axis %d move absolute to %f, base velocity=%f, velocity=%f, acceleration=%f\n",
+      driverName, functionName, portName, axis, value, baseVelocity, velocity, acceleration );
+
+  } else if (function == motorMoveVel_) {
+    pAxis->predictedEndTime_ = 0.;
+    status = pAxis->moveVelocity(baseVelocity, value, acceleration);
+    asynPrint(pAxis->pasynUser_, ASYN_TRACE_FLOW, 
+      "%s:%s: Set port %s, axis %d move with velocity of %f, acceleration=%f\n",
+      driverName, functionName, portName, axis, value, acceleration);
+
+  // Note, the motorHome command happens on the asynFloat64 interface, even though the value (direction) is really integer 
+  } else if (function == motorHome_) {
+    forwards = (value == 0) ? 0 : 1;
+    pAxis->predictedEndTime_ = 0.;
+    status = pAxis->home(baseVelocity, velocity, acceleration, forwards);
+    asynPrint(pAxis->pasynUser_, ASYN_TRACE_FLOW, 
+      "%s:%s: Set driver %s, axis %d to home %s, base velocity=%f, velocity=%f, acceleration=%f\n",
+      driverName, functionName, portName, axis, (forwards?"FORWARDS":"REVERSE"), baseVelocity, velocity, acceleration);
+  }
+  pAxis->setStatusBits(MOTOR_STATUS_DONE, 0);
+  pAxis->callParamCallbacks();
+  pAxis->pollRequested_ = 1;
+  wakeupPoller();
+  return status;
+}
+
 /** Called when asyn clients call pasynFloat64Array->write().
   * \param[in] pasynUser pasynUser structure that encodes the reason and address.
   * \param[in] value Pointer to the array to write.
@@ -531,6 +704,79 @@ asynStatus asynMotorController::readGenericPointer(asynUser *pasynUser, void *po
   return asynSuccess;
 }  
 
+/** Called when asyn clients call pasynGenericPointer->write().
+  * Handles the MotorMoveCompound structure written to motorMoveCompound_ by devMotorAsyn.
+  * The velocities, acceleration and move are passed to writeFloat64() in turn, exactly as
+  * if they had been written separately, but under a single lock and request.
+  * \param[in] pasynUser asynUser structure that encodes the reason and address.
+  * \param[in] pointer Pointer to the MotorMoveCompound structure. */
+asynStatus asynMotorController::writeGenericPointer(asynUser *pasynUser, void *pointer)
+{
+  MotorMoveCompound *pMove = (MotorMoveCompound *)pointer;
+  int function = pasynUser->reason;
+  int moveFunction;
+  asynStatus status = asynSuccess;
+  static const char *functionName = "writeGenericPointer";
+
+  if (function != motorMoveCompound_) return asynPortDriver::writeGenericPointer(pasynUser, pointer);
+  if (!getAxis(pasynUser)) return asynError;
+  updateMaxCommandWait(pasynUser, &maxCommandWait_);
+
+  switch (pMove->command) {
+    case MOTOR_MOVE_NONE: moveFunction = -1;           break;
+    case MOTOR_MOVE_ABS:  moveFunction = motorMoveAbs_; break;
+    case MOTOR_MOVE_REL:  moveFunction = motorMoveRel_; break;
+    case MOTOR_MOVE_VEL:  moveFunction = motorMoveVel_; break;
+    case MOTOR_MOVE_HOME: moveFunction = motorHome_;    break;
+    default:
+      asynPrint(pasynUser, ASYN_TRACE_ERROR,
+        "%s:%s: unknown compound move command %d\n",
+        driverName, functionName, pMove->command);
+      return asynError;
+  }
+
+  if (pMove->setMask & MOTOR_MOVE_SET_VEL_BASE) {
+    pasynUser->reason = motorVelBase_;
+    if (writeFloat64(pasynUser, pMove->baseVelocity)) status = asynError;
+  }
+  if (pMove->setMask & MOTOR_MOVE_SET_VELOCITY) {
+    pasynUser->reason = motorVelocity_;
+    if (writeFloat64(pasynUser, pMove->velocity)) status = asynError;
+  }
+  if (pMove->setMask & MOTOR_MOVE_SET_ACCEL) {
+    pasynUser->reason = motorAccel_;
+    if (writeFloat64(pasynUser, pMove->acceleration)) status = asynError;
+  }
+  if (moveFunction >= 0) {
+    pasynUser->reason = moveFunction;
+    if (writeFloat64(pasynUser, pMove->value)) status = asynError;
+  }
+  pasynUser->reason = function;
+  return status;
+}
+
+/** Returns the number of axes of this controller. */
+int asynMotorController::getNumAxes()
+{
+  return numAxes_;
+}
+
+/** Reads the status of an axis without taking the lock.
+  * See asynMotorAxis::readStatusSnapshot().
+  * \param[in] axisNo Axis index number.
+  * \param[out] pStatus The status.
+  * \param[out] pTimeStamp The time the status was last updated. */
+asynStatus asynMotorController::readStatusSnapshot(int axisNo, MotorStatus *pStatus, epicsTimeStamp *pTimeStamp)
+{
+  asynMotorAxis *pAxis;
+
+  if ((axisNo < 0) || (axisNo >= numAxes_)) return asynError;
+  pAxis = pAxes_[axisNo];
+  if (!pAxis) return asynError;
+  pAxis->readStatusSnapshot(pStatus, pTimeStamp);
+  return asynSuccess;
+}
+
 /** Returns a pointer to an asynMotorAxis object.
   * Returns NULL if the axis number encoded in pasynUser is invalid.
   * Derived classes will reimplement this function to return a pointer to the derived
@@ -570,12 +816,20 @@ asynMotorAxis* asynMotorController::getAxis(int axisNo)
   * \param[in] idlePollPeriod The time between polls when no axis is moving.
   * \param[in] forcedFastPolls The number of times to force the movingPollPeriod after waking up the poller.  
   * This can need to be non-zero for controllers that do not immediately
-  * report that an axis is moving after it has been told to start. */
+  * report that an axis is moving after it has been told to start.
+  * If asynMotorPollerPoolConfig() has been called the controller is added to the shared
+  * poller pool instead of creating its own thread. */
 asynStatus asynMotorController::startPoller(double movingPollPeriod, double idlePollPeriod, int forcedFastPolls)
 {
+  asynMotorPollerPool *pPool = asynMotorPollerPool::getPool();
+
   movingPollPeriod_ = movingPollPeriod;
   idlePollPeriod_   = idlePollPeriod;
   forcedFastPolls_  = forcedFastPolls;
+  if (pPool) {
+    pPollerPoolEntry_ = pPool->addController(this);
+    return asynSuccess;
+  }
   epicsThreadCreate("motorPoller", 
                     epicsThreadPriorityLow,
                     epicsThreadGetStackSize(epicsThreadStackMedium),
@@ -589,7 +843,8 @@ asynStatus asynMotorController::startPoller(double movingPollPeriod, double idle
   * starts polling quickly. */
 asynStatus asynMotorController::wakeupPoller()
 {
-  epicsEventSignal(pollEventId_);
+  if (pPollerPoolEntry_) asynMotorPollerPool::getPool()->wakeup(pPollerPoolEntry_);
+  else                   epicsEventSignal(pollEventId_);
   return asynSuccess;
 }
 
@@ -600,12 +855,27 @@ asynStatus asynMotorController::wakeupPoller()
   * are controller-wide parameters that need to be polled.  It can also be used for efficiency in some
   * cases. For example some controllers can return the status or positions for all axes in a single
   * command.  In that case asynMotorController::poll() could read that information, and then 
-  * asynMotorAxis::poll() might just extract the axis-specific information from the result. */
+  * asynMotorAxis::poll() might just extract the axis-specific information from the result.
+  * The simplest way to do this is to call initializeStatusSnapshot() in the constructor, and then fill
+  * in pStatusSnapshot_[axis] and set its valid flag for each axis in this method.  The poller then calls
+  * asynMotorAxis::setStatusSnapshot() rather than asynMotorAxis::poll() for those axes. */
 asynStatus asynMotorController::poll()
 {
   return asynSuccess;
 }
 
+/** Allocates the per-axis status snapshot array pStatusSnapshot_.
+  * Derived classes that read the status of all axes with a single command in poll() call this
+  * in their constructor.  Each cycle the poller clears the valid flags, calls poll(), and then
+  * for each axis whose entry poll() marked valid it calls asynMotorAxis::setStatusSnapshot()
+  * instead of asynMotorAxis::poll(). */
+asynStatus asynMotorController::initializeStatusSnapshot()
+{
+  if (pStatusSnapshot_) free(pStatusSnapshot_);
+  pStatusSnapshot_ = (MotorAxisSnapshot *)calloc(numAxes_, sizeof(MotorAxisSnapshot));
+  return asynSuccess;
+}
+
 static void asynMotorPollerC(void *drvPvt)
 {
   asynMotorController *pController = (asynMotorController*)drvPvt;
@@ -618,19 +888,27 @@ static void asynMotorPollerC(void *drvPvt)
   * any axis is moving.  It will immediately do a poll when asynMotorController::wakeupPoller() is
   * called, and will then do forcedFastPolls_ loops at the movingPollPeriod, before reverting back
   * to the idlePollPeriod_ if no axes are moving. It takes the lock on the port driver when it is polling.
+  *
+  * If adaptivePolling_ is set (see setAdaptivePolling()) each axis is instead polled on its own schedule:
+  * moving axes at the movingPollPeriod_ and idle axes at the idlePollPeriod_.  asynMotorController::poll()
+  * is still called once per cycle, but asynMotorAxis::poll() is only called for the axes that are due.
+  * The forced fast polls after a wakeup are applied to the axes that were commanded to move, or to all
+  * axes if the wakeup did not come from a command on a specific axis.
+  *
+  * If predictivePolling_ is set (see setPredictivePolling()) the axes are also polled on their own schedule.
+  * While an axis is moving to a position whose arrival time was predicted by predictMoveEnd() it is
+  * polled sparsely during the move, at most MAX_CRUISE_POLL_FACTOR moving poll periods apart, then exactly
+  * at the predicted end, and at the movingPollPeriod_ if the move takes longer than predicted.
+  *
+  * If the push receiver is running (see startPushReceiver()) and its connection is healthy, all axes
+  * are only polled at the watchdog period, apart from the forced fast polls after a wakeup.
+  *
+  * If pollerReleaseLock_ is set (see setPollerReleaseLock()) the lock is released and re-acquired
+  * after each axis is polled, so a command never waits longer than a single axis poll.
   */
 void asynMotorController::asynMotorPoller()
 {
   double timeout;
-  int i;
-  int forcedFastPolls=0;
-  bool anyMoving;
-  bool moving;
-  epicsTimeStamp nowTime;
-  double nowTimeSecs = 0.0;
-  asynMotorAxis *pAxis;
-  int autoPower = 0;
-  double autoPowerOffDelay = 0.0;
   int status;
 
   timeout = idlePollPeriod_;
@@ -639,67 +917,246 @@ void asynMotorController::asynMotorPoller()
   while(1) {
     if (timeout != 0.) status = epicsEventWaitWithTimeout(pollEventId_, timeout);
     else               status = epicsEventWait(pollEventId_);
-    if (status == epicsEventWaitOK) {
-      /* We got an event, rather than a timeout.  This is because other software
-       * knows that an axis should have changed state (started moving, etc.).
-       * Force a minimum number of fast polls, because the controller status
-       * might not have changed the first few polls
-       */
-      forcedFastPolls = forcedFastPolls_;
+    /* If we got an event, rather than a timeout, it is because other software
+     * knows that an axis should have changed state (started moving, etc.). */
+    timeout = pollCycle(status == epicsEventWaitOK);
+    if (timeout < 0.) break;
+  }
+}
+
+/** Runs one poll cycle of the controller.
+  * This is called by asynMotorPoller() each time it wakes up, or by a worker thread of the
+  * shared poller pool when the controller is due.  It takes the lock on the port driver,
+  * calls poll() and asynMotorAxis::poll() for the axes that need polling, handles auto power off,
+  * and releases the lock.
+  * \param[in] wokenUp true if the cycle was started by wakeupPoller() rather than by the poll period expiring.
+  * \returns The time to wait before the next cycle, 0 to wait until wakeupPoller() is called,
+  * or -1 if the controller is shutting down. */
+double asynMotorController::pollCycle(bool wokenUp)
+{
+  double timeout;
+  int i;
+  bool anyMoving;
+  bool moving;
+  bool axisRequested;
+  double pollTimeSecs;
+  double nextPollSecs;
+  double axisPeriod;
+  double lockTimeSecs;
+  double holdTime;
+  double axisTimeSecs;
+  double endTimeSecs;
+  double remainingTime;
+  bool perAxisSchedule;
+  asynMotorAxis *pAxis;
+  int autoPower = 0;
+  double autoPowerOffDelay = 0.0;
+
+  if (wokenUp) {
+    /* Force a minimum number of fast polls, because the controller status
+     * might not have changed the first few polls */
+    fastPollsLeft_ = forcedFastPolls_;
+  }
+  anyMoving = false;
+  lock();
+  if (shuttingDown_) {
+    unlock();
+    return -1.;
+  }
+
+  // Predictive polling needs each axis to be polled on its own schedule
+  perAxisSchedule = (adaptivePolling_ || predictivePolling_);
+  // The poll schedule uses the monotonic clock, so the lateness is not affected by clock steps
+  pollTimeSecs = getMonotonicSecs();
+  lockTimeSecs = pollTimeSecs;
+  if (expectedPollTime_ != 0.) {
+    if (!wokenUp) {
+      addPollHistogram(&pollLatenessHist_, 
+        (pollTimeSecs > expectedPollTime_) ? pollTimeSecs - expectedPollTime_ : 0.);
+    } else if (pollTimeSecs < expectedPollTime_) {
+      pollEarlyWakeups_++;
     }
-    anyMoving = false;
-    lock();
-    if (shuttingDown_) {
-      unlock();
-      break;
+  }
+  if (wokenUp) {
+    /* Axes that were commanded get the forced fast polls. If no axis asked for the wakeup
+     * it came from elsewhere in the driver, so all axes get them. */
+    axisRequested = false;
+    for (i=0; i<numAxes_; i++) {
+      pAxis=getAxis(i);
+      if (pAxis && pAxis->pollRequested_) axisRequested = true;
     }
-
-    poll();
     for (i=0; i<numAxes_; i++) {
       pAxis=getAxis(i);
       if (!pAxis) continue;
-      
-      getIntegerParam(i, motorPowerAutoOnOff_, &autoPower);
-      getDoubleParam(i, motorPowerOffDelay_, &autoPowerOffDelay);
-      
-      pAxis->poll(&moving);
-      if (moving) {
-	anyMoving = true;
-	pAxis->setWasMovingFlag(1);
-      } else {
-	if ((pAxis->getWasMovingFlag() == 1) && (autoPower == 1)) {
-	  pAxis->setDisableFlag(1);
-          pAxis->setWasMovingFlag(0);
-          epicsTimeGetCurrent(&nowTime);
-          pAxis->setLastEndOfMoveTime(nowTime.secPastEpoch + (nowTime.nsec / 1.e9));
-	}
+      if (!axisRequested || pAxis->pollRequested_) {
+        pAxis->forcedFastPolls_ = forcedFastPolls_;
+        pAxis->nextPollTime_ = pollTimeSecs;
       }
+      pAxis->pollRequested_ = 0;
+    }
+  }
 
-      //Auto power off drive, if:
-      //  We have detected an end of move
-      //  We are not moving again
-      //  Auto power off is enabled
-      //  Auto power off delay timer has expired
-      if ((!moving) && (autoPower == 1) && (pAxis->getDisableFlag() == 1)) {
-	epicsTimeGetCurrent(&nowTime);
-	nowTimeSecs = nowTime.secPastEpoch + (nowTime.nsec / 1.e9);
-	if ((nowTimeSecs - pAxis->getLastEndOfMoveTime()) >= autoPowerOffDelay) {
-	  pAxis->setClosedLoop(0);
-	  pAxis->setDisableFlag(0);
-	}
+  if (pStatusSnapshot_) {
+    for (i=0; i<numAxes_; i++) pStatusSnapshot_[i].valid = 0;
+  }
+  poll();
+  for (i=0; i<numAxes_; i++) {
+    pAxis=getAxis(i);
+    if (!pAxis) continue;
+    if (perAxisSchedule && (pollTimeSecs < pAxis->nextPollTime_)) continue;
+    if (pAxis->pendingMoveFunction_ >= 0) {
+      // The move starts when the auto power on delay expires, and that wakes up the poller
+      pAxis->nextPollTime_ = DBL_MAX;
+      continue;
+    }
+    
+    autoPower = pAxis->motionParams_.autoPower;
+    autoPowerOffDelay = pAxis->motionParams_.autoPowerOffDelay;
+    
+    axisTimeSecs = getMonotonicSecs();
+    if (pStatusSnapshot_ && pStatusSnapshot_[i].valid)
+      pAxis->setStatusSnapshot(&pStatusSnapshot_[i], &moving);
+    else
+      pAxis->poll(&moving);
+    addPollHistogram(&pollAxisHist_, getMonotonicSecs() - axisTimeSecs);
+    pAxis->pollCount_++;
+    // The axis may not have done callbacks if nothing changed, but the snapshot time shows it was polled
+    pAxis->publishStatus();
+    if (moving) {
+      anyMoving = true;
+      pAxis->setWasMovingFlag(1);
+    } else {
+      //Auto power off drive when the auto power off delay after the end of a move expires
+      if ((pAxis->getWasMovingFlag() == 1) && (autoPower == 1)) {
+        pAxis->setDisableFlag(1);
+        pAxis->setWasMovingFlag(0);
+        pAxis->setLastEndOfMoveTime(getCurrentSecs());
+        if (autoPowerOffDelay > 0.) {
+          pAxis->startAutoPowerTimer(AUTO_POWER_OFF_PENDING, autoPowerOffDelay);
+        } else {
+          pAxis->setClosedLoop(0);
+          pAxis->setDisableFlag(0);
+        }
       }
-
     }
-    if (forcedFastPolls > 0) {
-      timeout = movingPollPeriod_;
-      forcedFastPolls--;
-    } else if (anyMoving) {
-      timeout = movingPollPeriod_;
+
+    // Schedule the next poll of this axis
+    if (pAxis->forcedFastPolls_ > 0) {
+      axisPeriod = movingPollPeriod_;
+      pAxis->forcedFastPolls_--;
+    } else if (pushHealthy_) {
+      // The controller pushes status changes, so polling is only a watchdog
+      axisPeriod = pushWatchdogPeriod_;
+    } else if (moving && predictivePolling_ && (pAxis->predictedEndTime_ != 0.)) {
+      remainingTime = pAxis->predictedEndTime_ - pollTimeSecs;
+      if (remainingTime <= 0.) {
+        // The move has taken longer than predicted, fall back to the normal moving rate
+        axisPeriod = movingPollPeriod_;
+      } else if (remainingTime <= movingPollPeriod_) {
+        // Poll exactly when the move is predicted to end
+        axisPeriod = remainingTime;
+      } else {
+        // Poll sparsely while cruising, halving the time to the predicted end each poll,
+        // but often enough that the readbacks still update and a stall is seen
+        axisPeriod = remainingTime / 2.;
+        if (axisPeriod > MAX_CRUISE_POLL_FACTOR * movingPollPeriod_) axisPeriod = MAX_CRUISE_POLL_FACTOR * movingPollPeriod_;
+        if (axisPeriod < movingPollPeriod_) axisPeriod = movingPollPeriod_;
+      }
+    } else if (moving) {
+      axisPeriod = movingPollPeriod_;
     } else {
-      timeout = idlePollPeriod_;
+      axisPeriod = idlePollPeriod_;
+    }
+    if (!moving) pAxis->predictedEndTime_ = 0.;
+    // An idle poll period of 0 means only poll when woken up
+    if (axisPeriod != 0.) pAxis->nextPollTime_ = pollTimeSecs + axisPeriod;
+    else                  pAxis->nextPollTime_ = DBL_MAX;
+
+    // Give threads waiting to send commands a chance to get the lock before the next axis
+    if (pollerReleaseLock_ && (i < numAxes_-1)) {
+      holdTime = getMonotonicSecs() - lockTimeSecs;
+      if (holdTime > maxPollLockHold_) maxPollLockHold_ = holdTime;
+      unlock();
+      epicsThreadSleep(0.);
+      lock();
+      if (shuttingDown_) break;
+      lockTimeSecs = getMonotonicSecs();
     }
+  }
+  if (shuttingDown_) {
     unlock();
+    return -1.;
   }
+  if (perAxisSchedule) {
+    // Sleep until the next axis is due
+    nextPollSecs = DBL_MAX;
+    for (i=0; i<numAxes_; i++) {
+      pAxis=getAxis(i);
+      if (pAxis && (pAxis->nextPollTime_ < nextPollSecs)) nextPollSecs = pAxis->nextPollTime_;
+    }
+    if (nextPollSecs == DBL_MAX) {
+      timeout = 0.;
+    } else {
+      timeout = nextPollSecs - getMonotonicSecs();
+      // A timeout of 0 means wait forever, so use a minimal wait if an axis is already due
+      if (timeout < MIN_POLL_WAIT) timeout = MIN_POLL_WAIT;
+    }
+  } else if (fastPollsLeft_ > 0) {
+    timeout = movingPollPeriod_;
+    fastPollsLeft_--;
+  } else if (pushHealthy_) {
+    timeout = pushWatchdogPeriod_;
+  } else if (anyMoving) {
+    timeout = movingPollPeriod_;
+  } else {
+    timeout = idlePollPeriod_;
+  }
+  endTimeSecs = getMonotonicSecs();
+  holdTime = endTimeSecs - lockTimeSecs;
+  if (holdTime > maxPollLockHold_) maxPollLockHold_ = holdTime;
+  setDoubleParam(motorPollMaxLockWait_, maxCommandWait_);
+  setDoubleParam(motorPollMaxLockHold_, maxPollLockHold_);
+  addPollHistogram(&pollCycleHist_, endTimeSecs - pollTimeSecs);
+  expectedPollTime_ = (timeout != 0.) ? endTimeSecs + timeout : 0.;
+  // The histograms are published at most once per second
+  if (endTimeSecs - lastPollStatsTime_ >= 1.0) {
+    publishPollStatistics();
+    lastPollStatsTime_ = endTimeSecs;
+  }
+  callParamCallbacks();
+  unlock();
+  return timeout;
+}
+
+/** Clears the poller timing histograms and the early wakeup count, and publishes the cleared values.
+  * Must be called with the lock held. */
+void asynMotorController::resetPollStatistics()
+{
+  clearPollHistogram(&pollCycleHist_);
+  clearPollHistogram(&pollLatenessHist_);
+  clearPollHistogram(&pollAxisHist_);
+  pollEarlyWakeups_ = 0;
+  publishPollStatistics();
+}
+
+/** Sets the poller timing parameters from the histograms and does callbacks on the histogram arrays.
+  * Must be called with the lock held.  The scalar parameters are sent by the next callParamCallbacks(). */
+void asynMotorController::publishPollStatistics()
+{
+  MotorPollHistogram *hists[3] = {&pollCycleHist_, &pollLatenessHist_, &pollAxisHist_};
+  int histParams[3] = {motorPollCycleHist_, motorPollLatenessHist_, motorPollAxisHist_};
+  int minParams[3]  = {motorPollCycleMin_,  motorPollLatenessMin_,  motorPollAxisMin_};
+  int maxParams[3]  = {motorPollCycleMax_,  motorPollLatenessMax_,  motorPollAxisMax_};
+  int meanParams[3] = {motorPollCycleMean_, motorPollLatenessMean_, motorPollAxisMean_};
+  int i;
+
+  for (i=0; i<3; i++) {
+    setDoubleParam(minParams[i], hists[i]->min);
+    setDoubleParam(maxParams[i], hists[i]->max);
+    setDoubleParam(meanParams[i], hists[i]->num ? hists[i]->sum/hists[i]->num : 0.);
+    doCallbacksInt32Array(hists[i]->counts, MOTOR_POLL_HIST_BINS, histParams[i], 0);
+  }
+  setIntegerParam(motorPollEarlyWakeups_, pollEarlyWakeups_);
 }
 
 /**
@@ -750,6 +1207,118 @@ void asynMotorController::asynMotorMoveToHome()
 }
 
 
+/** Starts the thread that receives status pushed by the controller.
+  * Derived classes for controllers that can send unsolicited status messages (motion done, limit hit,
+  * position streams, etc.) call this after startPoller(), and implement readPushMessage() and
+  * processPushMessage().  While messages are being received without errors the poller backs off
+  * to polling every watchdogPeriod, and it returns to the normal poll periods if readPushMessage()
+  * returns an error.
+  * \param[in] watchdogPeriod The time between polls while pushed status is being received.  Must be
+  * greater than 0; it is also the timeout for readPushMessage(). */
+asynStatus asynMotorController::startPushReceiver(double watchdogPeriod)
+{
+  static const char *functionName = "startPushReceiver";
+
+  if (watchdogPeriod <= 0.) {
+    asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+      "%s:%s: %s watchdog period must be greater than 0, got %f\n", 
+      driverName, functionName, portName, watchdogPeriod);
+    return asynError;
+  }
+  pushWatchdogPeriod_ = watchdogPeriod;
+  epicsThreadCreate("motorPushReceiver", 
+                    epicsThreadPriorityMedium,
+                    epicsThreadGetStackSize(epicsThreadStackMedium),
+                    (EPICSTHREADFUNC)asynMotorPushReceiverC, (void *)this);
+  return asynSuccess;
+}
+
+/** Reads one message pushed by the controller.
+  * This is called by the push receiver thread without the lock held, so it can block waiting
+  * for the controller.  Derived classes that call startPushReceiver() must implement it, typically
+  * by reading from a second asynOctet connection to the controller.
+  * \param[out] message Buffer to receive the message.
+  * \param[in] maxLen Size of the buffer.
+  * \param[out] messageLen Number of bytes in the message.
+  * \param[in] timeout Maximum time to wait for a message.
+  * \returns asynSuccess if a message was read, asynTimeout if no message arrived within the timeout,
+  * any other status if the connection has failed. */
+asynStatus asynMotorController::readPushMessage(char *message, size_t maxLen, size_t *messageLen, double timeout)
+{
+  static const char *functionName = "readPushMessage";
+
+  asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+    "%s:%s: not implemented by this driver\n", 
+    driverName, functionName);
+  return asynError;
+}
+
+/** Processes one message pushed by the controller.
+  * This is called by the push receiver thread with the lock held.  Derived classes implement it
+  * to decode the message and call asynMotorAxis::setIntegerParam() and asynMotorAxis::setDoubleParam()
+  * for the axes it refers to.  The push receiver calls asynMotorAxis::callParamCallbacks() for all axes
+  * afterwards, so only the axes that changed do callbacks.
+  * \param[in] message The message.
+  * \param[in] messageLen Number of bytes in the message. */
+asynStatus asynMotorController::processPushMessage(const char *message, size_t messageLen)
+{
+  return asynSuccess;
+}
+
+static void asynMotorPushReceiverC(void *drvPvt)
+{
+  asynMotorController *pController = (asynMotorController*)drvPvt;
+  pController->asynMotorPushReceiver();
+}
+
+/** Push receiver thread function, started by startPushReceiver().
+  * Not normally overridden. */
+void asynMotorController::asynMotorPushReceiver()
+{
+  asynMotorAxis *pAxis;
+  asynStatus status;
+  size_t messageLen;
+  int i;
+  static const char *functionName = "asynMotorPushReceiver";
+
+  while (1) {
+    messageLen = 0;
+    // Wait for a message without holding the lock
+    status = readPushMessage(pushMessage_, sizeof(pushMessage_), &messageLen, pushWatchdogPeriod_);
+    lock();
+    if (shuttingDown_) {
+      unlock();
+      break;
+    }
+    if (status == asynSuccess) {
+      pushMessages_++;
+      processPushMessage(pushMessage_, messageLen);
+      for (i=0; i<numAxes_; i++) {
+        pAxis = getAxis(i);
+        if (pAxis) pAxis->callParamCallbacks();
+      }
+      // The poller backs off at the end of its next cycle
+      pushHealthy_ = 1;
+    } else if (status == asynTimeout) {
+      // No status changes, which is normal for an idle controller, so leave pushHealthy_ as it is
+    } else {
+      pushErrors_++;
+      if (pushHealthy_) {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR,
+          "%s:%s: error receiving pushed status from %s, status=%d, resuming normal polling\n", 
+          driverName, functionName, portName, status);
+        pushHealthy_ = 0;
+        wakeupPoller();
+      }
+    }
+    unlock();
+    // Do not spin on a broken connection
+    if ((status != asynSuccess) && (status != asynTimeout))
+      epicsThreadSleep(pushWatchdogPeriod_);
+  }
+}
+
+
 /** Writes a string to the controller.
   * Calls writeController() with a default location of the string to write and a default timeout. */ 
 asynStatus asynMotorController::writeController()
@@ -953,6 +1522,91 @@ asynStatus asynMotorController::setIdlePollPeriod(double idlePollPeriod)
   return asynSuccess;
 }
 
+/** Enable or disable per-axis adaptive poll scheduling at runtime.
+  * \param[in] adaptivePolling 1 to poll each axis on its own schedule, 0 to poll all axes every cycle. */
+asynStatus asynMotorController::setAdaptivePolling(int adaptivePolling)
+{
+  static const char *functionName = "setAdaptivePolling";
+
+  asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+    "%s:%s: Setting adaptive polling to %d\n", 
+    driverName, functionName, adaptivePolling);
+
+  lock();
+  adaptivePolling_ = adaptivePolling;
+  wakeupPoller();
+  unlock();
+  return asynSuccess;
+}
+
+/** Enable or disable predictive polling at runtime.
+  * \param[in] predictivePolling 1 to schedule the polls of moving axes around the predicted end of the move, 0 to
+  * poll moving axes at the movingPollPeriod_. */
+asynStatus asynMotorController::setPredictivePolling(int predictivePolling)
+{
+  static const char *functionName = "setPredictivePolling";
+
+  asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+    "%s:%s: Setting predictive polling to %d\n", 
+    driverName, functionName, predictivePolling);
+
+  lock();
+  predictivePolling_ = predictivePolling;
+  wakeupPoller();
+  unlock();
+  return asynSuccess;
+}
+
+/** Predicts when a move will end, for predictive polling.
+  * This assumes a trapezoidal velocity profile starting and ending at the base velocity.
+  * It does nothing if predictive polling is not enabled or the velocity is not known.
+  * \param[in] pAxis The axis that is about to move.
+  * \param[in] distance The distance of the move. Units=steps.
+  * \param[in] baseVelocity The base velocity. Units=steps/sec.
+  * \param[in] velocity The maximum velocity. Units=steps/sec.
+  * \param[in] acceleration The acceleration. Units=steps/sec/sec. */
+void asynMotorController::predictMoveEnd(asynMotorAxis *pAxis, double distance, double baseVelocity,
+                                         double velocity, double acceleration)
+{
+  double accelDistance;
+  double peakVelocity;
+  double moveTime;
+
+  pAxis->predictedEndTime_ = 0.;
+  if (!predictivePolling_ || (velocity <= 0.)) return;
+  baseVelocity = fabs(baseVelocity);
+  velocity = fabs(velocity);
+  if ((acceleration <= 0.) || (velocity <= baseVelocity)) {
+    moveTime = distance / velocity;
+  } else {
+    accelDistance = (velocity*velocity - baseVelocity*baseVelocity) / (2.*acceleration);
+    if (2.*accelDistance >= distance) {
+      // The move never reaches full velocity
+      peakVelocity = sqrt(baseVelocity*baseVelocity + acceleration*distance);
+      moveTime = 2.*(peakVelocity - baseVelocity) / acceleration;
+    } else {
+      moveTime = 2.*(velocity - baseVelocity) / acceleration + (distance - 2.*accelDistance) / velocity;
+    }
+  }
+  pAxis->predictedEndTime_ = getMonotonicSecs() + moveTime;
+}
+
+/** Enable or disable releasing the lock between axes in the poller.
+  * \param[in] releaseLock 1 to release the lock after each axis is polled, 0 to hold it for the whole poll cycle. */
+asynStatus asynMotorController::setPollerReleaseLock(int releaseLock)
+{
+  static const char *functionName = "setPollerReleaseLock";
+
+  asynPrint(pasynUserSelf, ASYN_TRACE_FLOW,
+    "%s:%s: Setting poller release lock to %d\n", 
+    driverName, functionName, releaseLock);
+
+  lock();
+  pollerReleaseLock_ = releaseLock;
+  unlock();
+  return asynSuccess;
+}
+
 /** The following functions have C linkage, and can be called directly or from iocsh */
 
 extern "C" {
@@ -986,6 +1640,67 @@ asynStatus setIdlePollPeriod(const char *portName, double idlePollPeriod)
 }
 
 
+asynStatus setAdaptivePolling(const char *portName, int adaptivePolling)
+{
+  asynMotorController *pC;
+  static const char *functionName = "setAdaptivePolling";
+
+  pC = (asynMotorController*) findAsynPortDriver(portName);
+  if (!pC) {
+    printf("%s:%s: Error port %s not found\n", driverName, functionName, portName);
+    return asynError;
+  }
+    
+  return pC->setAdaptivePolling(adaptivePolling);
+}
+asynStatus setPredictivePolling(const char *portName, int predictivePolling)
+{
+  asynMotorController *pC;
+  static const char *functionName = "setPredictivePolling";
+
+  pC = (asynMotorController*) findAsynPortDriver(portName);
+  if (!pC) {
+    printf("%s:%s: Error port %s not found\n", driverName, functionName, portName);
+    return asynError;
+  }
+    
+  return pC->setPredictivePolling(predictivePolling);
+}
+
+
+asynStatus setPollerReleaseLock(const char *portName, int releaseLock)
+{
+  asynMotorController *pC;
+  static const char *functionName = "setPollerReleaseLock";
+
+  pC = (asynMotorController*) findAsynPortDriver(portName);
+  if (!pC) {
+    printf("%s:%s: Error port %s not found\n", driverName, functionName, portName);
+    return asynError;
+  }
+    
+  return pC->setPollerReleaseLock(releaseLock);
+}
+
+int asynMotorGetNumAxes(const char *portName)
+{
+  asynMotorController *pC;
+
+  pC = (asynMotorController*) findAsynPortDriver(portName);
+  if (!pC) return -1;
+  return pC->getNumAxes();
+}
+
+
+int asynMotorReadStatusSnapshot(const char *portName, int axis, MotorStatus *pStatus, epicsTimeStamp *pTimeStamp)
+{
+  asynMotorController *pC;
+
+  pC = (asynMotorController*) findAsynPortDriver(portName);
+  if (!pC) return -1;
+  return (pC->readStatusSnapshot(axis, pStatus, pTimeStamp) == asynSuccess) ? 0 : -1;
+}
+
 
 asynStatus asynMotorEnableMoveToHome(const char *portName, int axis, int distance)
 {
@@ -1039,6 +1754,52 @@ static void setIdlePollPeriodCallFunc(const iocshArgBuf *args)
   setIdlePollPeriod(args[0].sval, args[1].dval);
 }
 
+/* setAdaptivePolling */
+static const iocshArg setAdaptivePollingArg0 = {"Controller port name", iocshArgString};
+static const iocshArg setAdaptivePollingArg1 = {"Enable", iocshArgInt};
+static const iocshArg * const setAdaptivePollingArgs[] = {&setAdaptivePollingArg0,
+                                                          &setAdaptivePollingArg1};
+static const iocshFuncDef setAdaptivePollingDef = {"setAdaptivePolling", 2, setAdaptivePollingArgs};
+
+static void setAdaptivePollingCallFunc(const iocshArgBuf *args)
+{
+  setAdaptivePolling(args[0].sval, args[1].ival);
+}
+
+/* setPredictivePolling */
+static const iocshArg setPredictivePollingArg0 = {"Controller port name", iocshArgString};
+static const iocshArg setPredictivePollingArg1 = {"Enable", iocshArgInt};
+static const iocshArg * const setPredictivePollingArgs[] = {&setPredictivePollingArg0,
+                                                            &setPredictivePollingArg1};
+static const iocshFuncDef setPredictivePollingDef = {"setPredictivePolling", 2, setPredictivePollingArgs};
+
+static void setPredictivePollingCallFunc(const iocshArgBuf *args)
+{
+  setPredictivePolling(args[0].sval, args[1].ival);
+}
+
+/* setPollerReleaseLock */
+static const iocshArg setPollerReleaseLockArg0 = {"Controller port name", iocshArgString};
+static const iocshArg setPollerReleaseLockArg1 = {"Enable", iocshArgInt};
+static const iocshArg * const setPollerReleaseLockArgs[] = {&setPollerReleaseLockArg0,
+                                                            &setPollerReleaseLockArg1};
+static const iocshFuncDef setPollerReleaseLockDef = {"setPollerReleaseLock", 2, setPollerReleaseLockArgs};
+
+static void setPollerReleaseLockCallFunc(const iocshArgBuf *args)
+{
+  setPollerReleaseLock(args[0].sval, args[1].ival);
+}
+
+/* asynMotorPollerPoolConfig */
+static const iocshArg asynMotorPollerPoolConfigArg0 = {"Number of threads", iocshArgInt};
+static const iocshArg * const asynMotorPollerPoolConfigArgs[] = {&asynMotorPollerPoolConfigArg0};
+static const iocshFuncDef asynMotorPollerPoolConfigDef = {"asynMotorPollerPoolConfig", 1, asynMotorPollerPoolConfigArgs};
+
+static void asynMotorPollerPoolConfigCallFunc(const iocshArgBuf *args)
+{
+  asynMotorPollerPoolConfig(args[0].ival);
+}
+
 
 /* asynMotorEnableMoveToHome */
 static const iocshArg asynMotorEnableMoveToHomeArg0 = {"Controller port name", iocshArgString};
@@ -1059,6 +1820,10 @@ static void asynMotorControllerRegister(void)
 {
   iocshRegister(&setMovingPollPeriodDef, setMovingPollPeriodCallFunc);
   iocshRegister(&setIdlePollPeriodDef, setIdlePollPeriodCallFunc);
+  iocshRegister(&setAdaptivePollingDef, setAdaptivePollingCallFunc);
+  iocshRegister(&setPredictivePollingDef, setPredictivePollingCallFunc);
+  iocshRegister(&setPollerReleaseLockDef, setPollerReleaseLockCallFunc);
+  iocshRegister(&asynMotorPollerPoolConfigDef, asynMotorPollerPoolConfigCallFunc);
   iocshRegister(&enableMoveToHome, enableMoveToHomeCallFunc);
 }
 epicsExportRegistrar(asynMotorControllerRegister);
@@ -9,6 +9,8 @@
 #define asynMotorController_H
 
 #include <epicsEvent.h>
+#include <epicsTimer.h>
+#include <epicsTime.h>
 #include <epicsTypes.h>
 #include <shareLib.h>
 
@@ -23,6 +25,7 @@
 #define motorMoveAbsString              "MOTOR_MOVE_ABS"
 #define motorMoveVelString              "MOTOR_MOVE_VEL"
 #define motorHomeString                 "MOTOR_HOME"
+#define motorMoveCompoundString         "MOTOR_MOVE_COMPOUND"
 #define motorStopString                 "MOTOR_STOP_AXIS"
 #define motorActVelocityString          "MOTOR_ACT_VELOCITY"
 #define motorVelocityString             "MOTOR_VELOCITY"
@@ -68,6 +71,12 @@
 #define motorRecDirectionString         "MOTOR_REC_DIRECTION"
 #define motorRecOffsetString            "MOTOR_REC_OFFSET"
 
+/* These are per-axis parameters that limit the status callbacks to device support */
+#define motorPositionDeadbandString     "MOTOR_POSITION_DEADBAND"
+#define motorEncoderDeadbandString      "MOTOR_ENCODER_DEADBAND"
+#define motorVelocityDeadbandString     "MOTOR_VELOCITY_DEADBAND"
+#define motorMaxStatusRateString        "MOTOR_MAX_STATUS_RATE"
+
 /* These are the per-controller parameters for profile moves (coordinated motion) */
 #define profileNumAxesString            "PROFILE_NUM_AXES"
 #define profileNumPointsString          "PROFILE_NUM_POINTS"
@@ -109,6 +118,44 @@
 #define PCOPulseWidthString             "PCO_PULSE_WIDTH"
 #define PCOEnableString                 "PCO_ENABLE"
 
+/* These are the per-controller parameters for poller diagnostics */
+#define motorPollMaxLockWaitString      "MOTOR_POLL_MAX_LOCK_WAIT"
+#define motorPollMaxLockHoldString      "MOTOR_POLL_MAX_LOCK_HOLD"
+#define motorPollCycleHistString        "MOTOR_POLL_CYCLE_HIST"
+#define motorPollCycleMinString         "MOTOR_POLL_CYCLE_MIN"
+#define motorPollCycleMaxString         "MOTOR_POLL_CYCLE_MAX"
+#define motorPollCycleMeanString        "MOTOR_POLL_CYCLE_MEAN"
+#define motorPollLatenessHistString     "MOTOR_POLL_LATENESS_HIST"
+#define motorPollLatenessMinString      "MOTOR_POLL_LATENESS_MIN"
+#define motorPollLatenessMaxString      "MOTOR_POLL_LATENESS_MAX"
+#define motorPollLatenessMeanString     "MOTOR_POLL_LATENESS_MEAN"
+#define motorPollAxisHistString         "MOTOR_POLL_AXIS_HIST"
+#define motorPollAxisMinString          "MOTOR_POLL_AXIS_MIN"
+#define motorPollAxisMaxString          "MOTOR_POLL_AXIS_MAX"
+#define motorPollAxisMeanString         "MOTOR_POLL_AXIS_MEAN"
+#define motorPollEarlyWakeupsString     "MOTOR_POLL_EARLY_WAKEUPS"
+#define motorPollStatsResetString       "MOTOR_POLL_STATS_RESET"
+
+/** Bits in MotorStatus.status.  These are in the same order as the motorStatus parameters
+  * (motorStatusDirection_ ... motorStatusHomed_) and as the bits the motor record expects in MSTA. */
+#define MOTOR_STATUS_DIRECTION          0x0001
+#define MOTOR_STATUS_DONE               0x0002
+#define MOTOR_STATUS_HIGH_LIMIT         0x0004
+#define MOTOR_STATUS_AT_HOME            0x0008
+#define MOTOR_STATUS_SLIP               0x0010
+#define MOTOR_STATUS_POWERED            0x0020
+#define MOTOR_STATUS_FOLLOWING_ERROR    0x0040
+#define MOTOR_STATUS_HOME               0x0080
+#define MOTOR_STATUS_HAS_ENCODER        0x0100
+#define MOTOR_STATUS_PROBLEM            0x0200
+#define MOTOR_STATUS_MOVING             0x0400
+#define MOTOR_STATUS_GAIN_SUPPORT       0x0800
+#define MOTOR_STATUS_COMMS_ERROR        0x1000
+#define MOTOR_STATUS_LOW_LIMIT          0x2000
+#define MOTOR_STATUS_HOMED              0x4000
+#define MOTOR_STATUS_NUM_BITS           15
+#define MOTOR_STATUS_ALL_BITS           0x7FFF
+
 /** The structure that is passed back to devMotorAsyn when the status changes. */
 typedef struct MotorStatus {
   double position;           /**< Commanded motor position */
@@ -117,6 +164,53 @@ typedef struct MotorStatus {
   epicsUInt32 status;        /**< Word containing status bits (motion done, limits, etc.) */
 } MotorStatus;
 
+/** The status of one axis as read by asynMotorController::poll() for all axes at once.
+  * See asynMotorController::initializeStatusSnapshot(). */
+typedef struct MotorAxisSnapshot {
+  double position;           /**< Commanded motor position */
+  double encoderPosition;    /**< Actual encoder position */
+  double velocity;           /**< Actual velocity */
+  epicsUInt32 status;        /**< Status bits, in the same order as the motorStatus parameters */
+  int valid;                 /**< Set by poll() if this entry was filled in during this poll cycle */
+} MotorAxisSnapshot;
+
+/** Number of bins in the poller timing histograms.  The upper edges of the bins are
+  * 1, 2, 5, 10, 20, 50, 100, 200, 500 and 1000 ms, and the last bin counts everything longer. */
+#define MOTOR_POLL_HIST_BINS 11
+
+/** A histogram of times measured by the poller, with min/max/mean */
+typedef struct MotorPollHistogram {
+  epicsInt32 counts[MOTOR_POLL_HIST_BINS];  /**< Number of samples in each bin */
+  double min;                               /**< Shortest time, in seconds */
+  double max;                               /**< Longest time, in seconds */
+  double sum;                               /**< Sum of all times, for the mean */
+  unsigned long num;                        /**< Number of samples */
+} MotorPollHistogram;
+
+/** Values of MotorMoveCompound.command */
+#define MOTOR_MOVE_NONE                 0  /**< Only set the velocities and acceleration */
+#define MOTOR_MOVE_ABS                  1  /**< Absolute move, as motorMoveAbs_ */
+#define MOTOR_MOVE_REL                  2  /**< Relative move, as motorMoveRel_ */
+#define MOTOR_MOVE_VEL                  3  /**< Jog, as motorMoveVel_ */
+#define MOTOR_MOVE_HOME                 4  /**< Home, as motorHome_ */
+
+/** Bits in MotorMoveCompound.setMask */
+#define MOTOR_MOVE_SET_VEL_BASE         0x1
+#define MOTOR_MOVE_SET_VELOCITY         0x2
+#define MOTOR_MOVE_SET_ACCEL            0x4
+
+/** A move together with the motion parameters it uses.  devMotorAsyn writes this to
+  * motorMoveCompound_ with asynGenericPointer, so that a move is one queued request
+  * instead of one for each of the velocities, the acceleration and the move itself. */
+typedef struct MotorMoveCompound {
+  int command;               /**< MOTOR_MOVE_NONE, MOTOR_MOVE_ABS, etc. */
+  double value;              /**< The value that would be written to the individual move parameter */
+  int setMask;               /**< MOTOR_MOVE_SET_* bits for the fields below that are valid */
+  double baseVelocity;       /**< Value for motorVelBase_ */
+  double velocity;           /**< Value for motorVelocity_ */
+  double acceleration;       /**< Value for motorAccel_ */
+} MotorMoveCompound;
+
 enum ProfileTimeMode{
   PROFILE_TIME_MODE_FIXED,
   PROFILE_TIME_MODE_ARRAY
@@ -156,10 +250,24 @@ enum ProfileStatus {
   PROFILE_STATUS_TIMEOUT
 };
 
+/* These functions read the latest status of an axis without taking the port lock,
+ * for monitoring code that must not wait for the poller.  They return 0 on success
+ * and -1 if the port or axis does not exist. */
+#ifdef __cplusplus
+extern "C" {
+#endif
+epicsShareFunc int asynMotorGetNumAxes(const char *portName);
+epicsShareFunc int asynMotorReadStatusSnapshot(const char *portName, int axis,
+                                               MotorStatus *pStatus, epicsTimeStamp *pTimeStamp);
+#ifdef __cplusplus
+}
+#endif
+
 #ifdef __cplusplus
 #include <asynPortDriver.h>
 
 class asynMotorAxis;
+struct asynMotorPollerPoolEntry;
 
 class epicsShareClass asynMotorController : public asynPortDriver {
 
@@ -177,6 +285,7 @@ class epicsShareClass asynMotorController : public asynPortDriver {
   virtual asynStatus writeFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements);
   virtual asynStatus readFloat64Array(asynUser *pasynUser, epicsFloat64 *value, size_t nElements, size_t *nRead);
   virtual asynStatus readGenericPointer(asynUser *pasynUser, void *pointer);
+  virtual asynStatus writeGenericPointer(asynUser *pasynUser, void *pointer);
   virtual void report(FILE *fp, int details);
 
   /* These are the methods that are new to this class */
@@ -186,8 +295,21 @@ class epicsShareClass asynMotorController : public asynPortDriver {
   virtual asynStatus wakeupPoller();
   virtual asynStatus poll();
   virtual asynStatus setDeferredMoves(bool defer);
+  virtual asynStatus initializeStatusSnapshot();
+  int getNumAxes();
+  asynStatus readStatusSnapshot(int axisNo, MotorStatus *pStatus, epicsTimeStamp *pTimeStamp);
   void asynMotorPoller();  // This should be private but is called from C function
+  double pollCycle(bool wokenUp);  // This should be private but is called from the poller pool
+  void resetPollStatistics();
+  void publishPollStatistics();
+  void predictMoveEnd(asynMotorAxis *pAxis, double distance, double baseVelocity, double velocity, double acceleration);
   
+  /* Functions to deal with status pushed by the controller */
+  virtual asynStatus startPushReceiver(double watchdogPeriod);
+  virtual asynStatus readPushMessage(char *message, size_t maxLen, size_t *messageLen, double timeout);
+  virtual asynStatus processPushMessage(const char *message, size_t messageLen);
+  void asynMotorPushReceiver();  // This should be private but is called from C function
+
   /* Functions to deal with moveToHome.*/
   virtual asynStatus startMoveToHomeThread();
   void asynMotorMoveToHome();
@@ -201,6 +323,9 @@ class epicsShareClass asynMotorController : public asynPortDriver {
   
   virtual asynStatus setMovingPollPeriod(double movingPollPeriod);
   virtual asynStatus setIdlePollPeriod(double idlePollPeriod);
+  virtual asynStatus setAdaptivePolling(int adaptivePolling);
+  virtual asynStatus setPredictivePolling(int predictivePolling);
+  virtual asynStatus setPollerReleaseLock(int releaseLock);
 
   int shuttingDown_;   /**< Flag indicating that IOC is shutting down.  Stops poller */
 
@@ -237,6 +362,7 @@ class epicsShareClass asynMotorController : public asynPortDriver {
   int motorPostMoveDelay_;
   int motorStatus_;
   int motorUpdateStatus_;
+  int motorMoveCompound_;
 
   // These are the status bits
   int motorStatusDirection_;
@@ -260,6 +386,12 @@ class epicsShareClass asynMotorController : public asynPortDriver {
   int motorRecDirection_;
   int motorRecOffset_;
 
+  // These are per-axis parameters that limit the status callbacks to device support
+  int motorPositionDeadband_;
+  int motorEncoderDeadband_;
+  int motorVelocityDeadband_;
+  int motorMaxStatusRate_;
+
   // These are the per-controller parameters for profile moves
   int profileNumAxes_;
   int profileNumPoints_;
@@ -301,6 +433,24 @@ class epicsShareClass asynMotorController : public asynPortDriver {
   int PCOPulseWidth_;
   int PCOEnable_;
 
+  // These are the per-controller parameters for poller diagnostics
+  int motorPollMaxLockWait_;
+  int motorPollMaxLockHold_;
+  int motorPollCycleHist_;
+  int motorPollCycleMin_;
+  int motorPollCycleMax_;
+  int motorPollCycleMean_;
+  int motorPollLatenessHist_;
+  int motorPollLatenessMin_;
+  int motorPollLatenessMax_;
+  int motorPollLatenessMean_;
+  int motorPollAxisHist_;
+  int motorPollAxisMin_;
+  int motorPollAxisMax_;
+  int motorPollAxisMean_;
+  int motorPollEarlyWakeups_;
+  int motorPollStatsReset_;
+
   int numAxes_;                 /**< Number of axes this controller supports */
   asynMotorAxis **pAxes_;       /**< Array of pointers to axis objects */
   epicsEventId pollEventId_;    /**< Event ID to wake up poller */
@@ -308,12 +458,35 @@ class epicsShareClass asynMotorController : public asynPortDriver {
   double idlePollPeriod_;       /**< The time between polls when no axes are moving */
   double movingPollPeriod_;     /**< The time between polls when any axis is moving */
   int    forcedFastPolls_;      /**< The number of forced fast polls when the poller wakes up */
+  int    fastPollsLeft_;        /**< The number of forced fast polls remaining since the last wakeup */
+  asynMotorPollerPoolEntry *pPollerPoolEntry_;  /**< Entry in the shared poller pool, NULL if this controller has its own poller thread */
+  int    adaptivePolling_;      /**< Poll each axis on its own schedule rather than all axes every cycle */
+  int    predictivePolling_;    /**< Schedule polls of moving axes around the predicted end of the move */
+  int    pollerReleaseLock_;    /**< Poller releases the lock between axes so commands are not blocked for a whole cycle */
+  double maxCommandWait_;       /**< Longest time a move or stop command from device support waited between being queued and its write starting */
+  double maxPollLockHold_;      /**< Longest time the poller has held the lock without releasing it */
+  MotorPollHistogram pollCycleHist_;     /**< Duration of poll cycles */
+  MotorPollHistogram pollLatenessHist_;  /**< How late poll cycles started after the poll period expired */
+  MotorPollHistogram pollAxisHist_;      /**< Duration of asynMotorAxis::poll() calls, one histogram for all axes */
+  int    pollEarlyWakeups_;     /**< Number of poll cycles started by wakeupPoller() before the poll period expired */
+  double expectedPollTime_;     /**< Monotonic time at which the next poll cycle is due, 0 if it waits for wakeupPoller() */
+  double lastPollStatsTime_;    /**< Time the poller statistics were last published */
  
+  int    pushHealthy_;          /**< A pushed message has been received and the connection has had no errors since */
+  double pushWatchdogPeriod_;   /**< The time between polls while pushHealthy_ is set */
+  unsigned long pushMessages_;  /**< Number of pushed messages processed */
+  unsigned long pushErrors_;    /**< Number of errors from readPushMessage() */
+
+  MotorAxisSnapshot *pStatusSnapshot_;  /**< Per-axis status filled in by poll(), NULL if not used */
+
   size_t maxProfilePoints_;     /**< Maximum number of profile points */
   double *profileTimes_;        /**< Array of times per profile point */
 
   int moveToHomeAxis_;
 
+  epicsTimerQueueId autoPowerTimerQueue_;  /**< Shared timer queue for the auto power delays, allocated when first needed */
+  asynStatus startMove(asynMotorAxis *pAxis, int function, double value);
+
   /* These are convenience functions for controllers that use asynOctet interfaces to the hardware */
   asynStatus writeController();
   asynStatus writeController(const char *output, double timeout);
@@ -324,6 +497,7 @@ class epicsShareClass asynMotorController : public asynPortDriver {
   asynUser *pasynUserController_;
   char outString_[MAX_CONTROLLER_STRING_SIZE];
   char inString_[MAX_CONTROLLER_STRING_SIZE];
+  char pushMessage_[MAX_CONTROLLER_STRING_SIZE];
 
   friend class asynMotorAxis;
 };
@@ -0,0 +1,252 @@
+/* asynMotorPollerPool.cpp
+ *
+ * This file implements a pool of threads that runs the poll cycles of many
+ * asynMotorController objects.  IOCs with a large number of controllers
+ * otherwise need one mostly idle poller thread per controller.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <float.h>
+
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include <epicsStdio.h>
+
+#include <asynPortDriver.h>
+#include <epicsExport.h>
+#define epicsExportSharedSymbols
+#include <shareLib.h>
+#include "asynMotorController.h"
+#include "asynMotorPollerPool.h"
+#include "asynMotorTime.h"
+
+static const char *driverName = "asynMotorPollerPool";
+
+/* The single pool used by all controllers, NULL if asynMotorPollerPoolConfig() was not called */
+static asynMotorPollerPool *pPollerPool = NULL;
+
+static void asynMotorPollerPoolWorkerC(void *drvPvt);
+
+
+/** Creates the pool and starts its worker threads.
+  * \param[in] numThreads The number of worker threads. */
+asynMotorPollerPool::asynMotorPollerPool(int numThreads)
+  : numThreads_(numThreads), heap_(NULL), heapSize_(0), numControllers_(0),
+    numCycles_(0), maxLateness_(0.)
+{
+  char threadName[32];
+  int i;
+
+  mutexId_ = epicsMutexMustCreate();
+  eventId_ = epicsEventMustCreate(epicsEventEmpty);
+  for (i=0; i<numThreads_; i++) {
+    epicsSnprintf(threadName, sizeof(threadName), "motorPollPool%d", i);
+    epicsThreadCreate(threadName,
+                      epicsThreadPriorityLow,
+                      epicsThreadGetStackSize(epicsThreadStackMedium),
+                      (EPICSTHREADFUNC)asynMotorPollerPoolWorkerC, (void *)this);
+  }
+}
+
+/** Returns the pool, or NULL if asynMotorPollerPoolConfig() has not been called. */
+asynMotorPollerPool* asynMotorPollerPool::getPool()
+{
+  return pPollerPool;
+}
+
+/** Adds a controller to the pool.
+  * This is called from asynMotorController::startPoller().  The first poll cycle is
+  * run immediately, as it is with a dedicated poller thread.
+  * \param[in] pController The controller to poll.
+  * \returns The scheduling entry, which is passed to wakeup(). */
+asynMotorPollerPoolEntry* asynMotorPollerPool::addController(asynMotorController *pController)
+{
+  asynMotorPollerPoolEntry *pEntry;
+
+  pEntry = (asynMotorPollerPoolEntry *)calloc(1, sizeof(asynMotorPollerPoolEntry));
+  pEntry->pController = pController;
+  pEntry->heapIndex = -1;
+
+  epicsMutexMustLock(mutexId_);
+  numControllers_++;
+  // The heap never holds more entries than there are controllers
+  heap_ = (asynMotorPollerPoolEntry **)realloc(heap_, numControllers_*sizeof(asynMotorPollerPoolEntry *));
+  epicsMutexUnlock(mutexId_);
+  wakeup(pEntry);
+  return pEntry;
+}
+
+/** Makes a controller's next poll cycle run as soon as possible.
+  * This is called from asynMotorController::wakeupPoller().  If the cycle is already running
+  * the controller is requeued as due now when it finishes.
+  * \param[in] pEntry The entry returned by addController(). */
+void asynMotorPollerPool::wakeup(asynMotorPollerPoolEntry *pEntry)
+{
+  epicsMutexMustLock(mutexId_);
+  pEntry->wakeup = 1;
+  if (!pEntry->running) {
+    pEntry->dueTime = getMonotonicSecs();
+    if (pEntry->heapIndex < 0) push(pEntry);
+    else                       siftUp(pEntry->heapIndex);
+  }
+  epicsMutexUnlock(mutexId_);
+  epicsEventSignal(eventId_);
+}
+
+/** Reports on the pool.
+  * \param[in] fp File pointer for the report output.
+  * \param[in] details Level of detail. */
+void asynMotorPollerPool::report(FILE *fp, int details)
+{
+  epicsMutexMustLock(mutexId_);
+  fprintf(fp, "Motor poller pool: threads=%d, controllers=%d, queued=%d, cycles=%lu, max lateness=%f\n",
+    numThreads_, numControllers_, heapSize_, numCycles_, maxLateness_);
+  epicsMutexUnlock(mutexId_);
+}
+
+static void asynMotorPollerPoolWorkerC(void *drvPvt)
+{
+  asynMotorPollerPool *pPool = (asynMotorPollerPool*)drvPvt;
+  pPool->workerThread();
+}
+
+/** Worker thread function.
+  * Waits until the controller at the head of the heap is due, removes it from the heap,
+  * runs its poll cycle without holding the pool mutex, and then requeues it using the
+  * timeout returned by asynMotorController::pollCycle().  A timeout of 0 means the
+  * controller is only polled again after wakeupPoller(). */
+void asynMotorPollerPool::workerThread()
+{
+  asynMotorPollerPoolEntry *pEntry;
+  asynMotorController *pController;
+  double now;
+  double timeout;
+  bool wokenUp;
+
+  epicsMutexMustLock(mutexId_);
+  while (1) {
+    if (heapSize_ == 0) {
+      epicsMutexUnlock(mutexId_);
+      epicsEventWait(eventId_);
+      epicsMutexMustLock(mutexId_);
+      continue;
+    }
+    now = getMonotonicSecs();
+    if (heap_[0]->dueTime > now) {
+      timeout = heap_[0]->dueTime - now;
+      epicsMutexUnlock(mutexId_);
+      epicsEventWaitWithTimeout(eventId_, timeout);
+      epicsMutexMustLock(mutexId_);
+      continue;
+    }
+    pEntry = pop();
+    if (now - pEntry->dueTime > maxLateness_) maxLateness_ = now - pEntry->dueTime;
+    // Let another worker take the next controller if it is also due
+    if ((heapSize_ > 0) && (heap_[0]->dueTime <= now)) epicsEventSignal(eventId_);
+    pEntry->running = 1;
+    wokenUp = (pEntry->wakeup != 0);
+    pEntry->wakeup = 0;
+    pController = pEntry->pController;
+    epicsMutexUnlock(mutexId_);
+
+    timeout = pController->pollCycle(wokenUp);
+
+    epicsMutexMustLock(mutexId_);
+    pEntry->running = 0;
+    numCycles_++;
+    // A negative timeout means the controller is shutting down
+    if (timeout < 0.) continue;
+    now = getMonotonicSecs();
+    if (pEntry->wakeup)       pEntry->dueTime = now;
+    else if (timeout == 0.)   continue;
+    else                      pEntry->dueTime = now + timeout;
+    push(pEntry);
+    epicsEventSignal(eventId_);
+  }
+}
+
+/** Adds an entry to the heap.  Must be called with the mutex held. */
+void asynMotorPollerPool::push(asynMotorPollerPoolEntry *pEntry)
+{
+  pEntry->heapIndex = heapSize_;
+  heap_[heapSize_++] = pEntry;
+  siftUp(pEntry->heapIndex);
+}
+
+/** Removes and returns the entry with the earliest dueTime.  Must be called with the mutex held. */
+asynMotorPollerPoolEntry* asynMotorPollerPool::pop()
+{
+  asynMotorPollerPoolEntry *pEntry = heap_[0];
+
+  heapSize_--;
+  if (heapSize_ > 0) {
+    heap_[0] = heap_[heapSize_];
+    heap_[0]->heapIndex = 0;
+    siftDown(0);
+  }
+  pEntry->heapIndex = -1;
+  return pEntry;
+}
+
+void asynMotorPollerPool::siftUp(int index)
+{
+  int parent;
+
+  while (index > 0) {
+    parent = (index - 1) / 2;
+    if (heap_[parent]->dueTime <= heap_[index]->dueTime) break;
+    swap(parent, index);
+    index = parent;
+  }
+}
+
+void asynMotorPollerPool::siftDown(int index)
+{
+  int child;
+
+  while (1) {
+    child = 2*index + 1;
+    if (child >= heapSize_) break;
+    if ((child+1 < heapSize_) && (heap_[child+1]->dueTime < heap_[child]->dueTime)) child++;
+    if (heap_[index]->dueTime <= heap_[child]->dueTime) break;
+    swap(index, child);
+    index = child;
+  }
+}
+
+void asynMotorPollerPool::swap(int index1, int index2)
+{
+  asynMotorPollerPoolEntry *pTemp = heap_[index1];
+
+  heap_[index1] = heap_[index2];
+  heap_[index2] = pTemp;
+  heap_[index1]->heapIndex = index1;
+  heap_[index2]->heapIndex = index2;
+}
+
+
+/** The following functions have C linkage, and can be called directly or from iocsh */
+
+extern "C" {
+
+/** Creates the shared poller pool.
+  * Controllers that call startPoller() after this are polled by the pool instead of
+  * creating their own poller thread.
+  * \param[in] numThreads The number of worker threads. */
+int asynMotorPollerPoolConfig(int numThreads)
+{
+  static const char *functionName = "asynMotorPollerPoolConfig";
+
+  if (pPollerPool) {
+    printf("%s:%s: Error the poller pool already exists\n", driverName, functionName);
+    return asynError;
+  }
+  if (numThreads < 1) {
+    printf("%s:%s: Error numThreads must be at least 1\n", driverName, functionName);
+    return asynError;
+  }
+  pPollerPool = new asynMotorPollerPool(numThreads);
+  return asynSuccess;
+}
+
+} // extern C
@@ -0,0 +1,69 @@
+/* asynMotorPollerPool.h
+ *
+ * This file defines a pool of threads that runs the poll cycles of many
+ * asynMotorController objects, as an alternative to one poller thread per
+ * controller.  It is enabled with asynMotorPollerPoolConfig() before the
+ * controllers are created.
+ */
+#ifndef asynMotorPollerPool_H
+#define asynMotorPollerPool_H
+
+#include <stdio.h>
+
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <shareLib.h>
+
+#ifdef __cplusplus
+
+class asynMotorController;
+
+/** Scheduling state of one controller in the pool.
+  * The fields are only accessed with the pool mutex held. */
+struct asynMotorPollerPoolEntry {
+  asynMotorController *pController;  /**< The controller that is polled */
+  double dueTime;                    /**< Monotonic time at which the next poll cycle should start */
+  int heapIndex;                     /**< Position in the deadline heap, -1 if not queued */
+  int running;                       /**< A worker thread is running the poll cycle */
+  int wakeup;                        /**< wakeupPoller() was called since the last poll cycle started */
+};
+
+/** Pool of threads that runs asynMotorController::pollCycle() for all the controllers
+  * that were started while the pool exists.  The controllers are kept in a binary heap
+  * ordered by the time their next poll cycle is due.  A controller is only ever run by
+  * one worker thread at a time, and it takes its own port lock as it does with its own
+  * poller thread. */
+class epicsShareClass asynMotorPollerPool {
+
+  public:
+  asynMotorPollerPool(int numThreads);
+  static asynMotorPollerPool* getPool();
+
+  asynMotorPollerPoolEntry* addController(asynMotorController *pController);
+  void wakeup(asynMotorPollerPoolEntry *pEntry);
+  void report(FILE *fp, int details);
+  void workerThread();  // This should be private but is called from C function
+
+  private:
+  void push(asynMotorPollerPoolEntry *pEntry);
+  asynMotorPollerPoolEntry* pop();
+  void siftUp(int index);
+  void siftDown(int index);
+  void swap(int index1, int index2);
+
+  epicsMutexId mutexId_;             /**< Protects the heap and all entries */
+  epicsEventId eventId_;             /**< Signalled when the head of the heap may have changed */
+  int numThreads_;                   /**< Number of worker threads */
+  asynMotorPollerPoolEntry **heap_;  /**< Heap of queued controllers, earliest dueTime first */
+  int heapSize_;                     /**< Number of controllers in the heap */
+  int numControllers_;               /**< Number of controllers added to the pool */
+  unsigned long numCycles_;          /**< Total number of poll cycles run */
+  double maxLateness_;               /**< Longest time a poll cycle has started after it was due */
+};
+
+extern "C" {
+epicsShareFunc int asynMotorPollerPoolConfig(int numThreads);
+}
+
+#endif /* _cplusplus */
+#endif /* asynMotorPollerPool_H */
@@ -0,0 +1,32 @@
+/* asynMotorTime.h
+ *
+ * This file defines the clock used by the model 3 classes for poll schedules,
+ * timeouts and durations, which must not jump when the wall clock is set.
+ */
+#ifndef asynMotorTime_H
+#define asynMotorTime_H
+
+#include <epicsTime.h>
+#include <epicsVersion.h>
+
+#ifndef VERSION_INT
+#  define VERSION_INT(V,R,M,P) ( ((V)<<24) | ((R)<<16) | ((M)<<8) | (P))
+#endif
+
+#define MOTOR_BASE_VERSION_INT VERSION_INT(EPICS_VERSION,EPICS_REVISION,EPICS_MODIFICATION,EPICS_PATCH_LEVEL)
+
+/** Returns a monotonic time in seconds.
+  * epicsMonotonicGet() is only in EPICS base 3.16.1 and later; older versions use the wall clock. */
+static inline double getMonotonicSecs()
+{
+#if MOTOR_BASE_VERSION_INT >= VERSION_INT(3,16,1,0)
+  return epicsMonotonicGet() / 1.e9;
+#else
+  epicsTimeStamp nowTime;
+
+  epicsTimeGetCurrent(&nowTime);
+  return nowTime.secPastEpoch + (nowTime.nsec / 1.e9);
+#endif
+}
+
+#endif /* asynMotorTime_H */
@@ -52,6 +52,8 @@
 #include <math.h>
 
 #include "motor_epics_inc.h"
+#include <epicsMutex.h>
+#include <epicsTime.h>
 
 #include <asynDriver.h>
 #include <asynInt32.h>
@@ -69,6 +71,7 @@
 #include "motor_interface.h"
 
 /*Create the dset for devMotor */
+static long report( int interest );
 static long init( int after );
 static long init_record(struct motorRecord *);
 static CALLBACK_VALUE update_values(struct motorRecord *);
@@ -77,13 +80,14 @@ static RTN_STATUS build_trans( motor_cmnd, double *, struct motorRecord *);
 static RTN_STATUS end_trans(struct motorRecord *);
 static void asynCallback(asynUser *);
 static void statusCallback(void *, asynUser *, void *);
+static void processCallback(CALLBACK *);
 
-typedef enum {int32Type, float64Type, float64ArrayType} interfaceType;
+typedef enum {int32Type, float64Type, float64ArrayType, genericPointerType} interfaceType;
 
 struct motor_dset devMotorAsyn={ 
     {
          8,
-         NULL,
+         (DEVSUPFUN) report,
          (DEVSUPFUN) init,
          (DEVSUPFUN) init_record,
          NULL 
@@ -118,18 +122,26 @@ typedef enum motorCommand {
     motorSetClosedLoop,
     motorStatus,
     motorUpdateStatus,
+    motorMoveCompound,
     lastMotorCommand
 } motorCommand;
 #define NUM_MOTOR_COMMANDS lastMotorCommand
 
-typedef struct {
+typedef struct motorAsynMessage {
     motorCommand command;
     interfaceType interface;
     int ivalue;
     double dvalue;
+    MotorMoveCompound move;
+    asynUser *pasynUser;             /* The asynUser that is queued for this message */
+    int pooled;                      /* The message is from messagePool, not allocated */
+    struct motorAsynMessage *pnext;  /* Next message in the free list */
 } motorAsynMessage;
 
-typedef struct
+/* Number of requests each record can have queued to the driver without allocating */
+#define MESSAGE_POOL_SIZE 8
+
+typedef struct motorAsynPvt
 {
     struct motorRecord * pmr;
     int moveRequestPending;
@@ -151,8 +163,26 @@ typedef struct
     void *asynGenericPointerPvt;
     void *registrarPvt;
     int driverReasons[NUM_MOTOR_COMMANDS];
+    int compoundMove;               /* Driver supports motorMoveCompound */
+    MotorMoveCompound pendingMove;  /* Velocities and acceleration not yet sent to the driver */
+    epicsMutexId poolLock;          /* Protects the message pool, which is freed by asynCallback */
+    motorAsynMessage messagePool[MESSAGE_POOL_SIZE];
+    motorAsynMessage *freeMessages;
+    int messagesInUse;
+    int maxMessagesInUse;
+    unsigned long poolOverflows;    /* Number of messages allocated because the pool was empty */
+    struct motorAsynPvt *pnext;     /* Next record in pvtList, for report() */
+    epicsMutexId statusLock;        /* Protects latestStatus and processPending */
+    struct MotorStatus latestStatus;  /* Status from statusCallback, not yet seen by the record */
+    int processPending;             /* processCallback has been requested and not yet run */
+    CALLBACK processCb;
+    unsigned long statusCallbacks;  /* Number of statusCallback calls */
+    unsigned long statusCoalesced;  /* Number of those that did not need another process */
 } motorAsynPvt;
 
+/* All the records using this device support */
+static motorAsynPvt *pvtList = NULL;
+
 
 
 /* The init routine is used to set a flag to indicate that it is OK to call dbScanLock */
@@ -163,6 +193,76 @@ static long init( int after )
     return 0;
 }
 
+static long report( int interest )
+{
+    motorAsynPvt *pPvt;
+
+    for (pPvt = pvtList; pPvt; pPvt = pPvt->pnext) {
+        if ((interest < 1) && (pPvt->poolOverflows == 0)) continue;
+        printf("    %s: queued requests=%d, max queued=%d, pool size=%d, pool overflows=%lu\n",
+               pPvt->pmr->name, pPvt->messagesInUse, pPvt->maxMessagesInUse,
+               MESSAGE_POOL_SIZE, pPvt->poolOverflows);
+        if (interest >= 1)
+            printf("    %s: status callbacks=%lu, coalesced=%lu\n",
+                   pPvt->pmr->name, pPvt->statusCallbacks, pPvt->statusCoalesced);
+    }
+    return 0;
+}
+
+/* Gets a message and its asynUser from the record's pool.  The asynUser is needed
+ * because we can have multiple requests queued.  If more than MESSAGE_POOL_SIZE requests
+ * are queued the message is allocated, and it is freed by freeMessage() in the callback. */
+static motorAsynMessage *allocMessage(motorAsynPvt *pPvt)
+{
+    motorAsynMessage *pmsg;
+
+    epicsMutexMustLock(pPvt->poolLock);
+    pmsg = pPvt->freeMessages;
+    if (pmsg)
+        pPvt->freeMessages = pmsg->pnext;
+    else
+        pPvt->poolOverflows++;
+    pPvt->messagesInUse++;
+    if (pPvt->messagesInUse > pPvt->maxMessagesInUse)
+        pPvt->maxMessagesInUse = pPvt->messagesInUse;
+    epicsMutexUnlock(pPvt->poolLock);
+
+    if (!pmsg) {
+        pmsg = pasynManager->memMalloc(sizeof *pmsg);
+        pmsg->pasynUser = pasynManager->duplicateAsynUser(pPvt->pasynUser, asynCallback, 0);
+        pmsg->pasynUser->userData = pmsg;
+        pmsg->pooled = 0;
+    }
+    pmsg->ivalue=0;
+    pmsg->dvalue=0.;
+    pmsg->interface = float64Type;
+    return pmsg;
+}
+
+/* Returns a message to the pool, or frees it if it was allocated by allocMessage() */
+static void freeMessage(motorAsynPvt *pPvt, motorAsynMessage *pmsg)
+{
+    asynUser *pasynUser = pmsg->pasynUser;
+    int status;
+
+    epicsMutexMustLock(pPvt->poolLock);
+    pPvt->messagesInUse--;
+    if (pmsg->pooled) {
+        pmsg->pnext = pPvt->freeMessages;
+        pPvt->freeMessages = pmsg;
+    }
+    epicsMutexUnlock(pPvt->poolLock);
+    if (pmsg->pooled) return;
+
+    pasynManager->memFree(pmsg, sizeof(*pmsg));
+    status = pasynManager->freeAsynUser(pasynUser);
+    if (status != asynSuccess) {
+        asynPrint(pPvt->pasynUser, ASYN_TRACE_ERROR,
+                  "devMotorAsyn::freeMessage: %s error in freeAsynUser\n",
+                  pPvt->pmr->name);
+    }
+}
+
 static void init_controller(struct motorRecord *pmr, asynUser *pasynUser )
 {
     /* This routine is copied out of the old motordevCom and initialises the controller
@@ -258,6 +358,7 @@ static long init_record(struct motorRecord * pmr )
     asynUser *pasynUser;
     char *port, *userParam;
     int signal;
+    int i;
     asynStatus status;
     asynInterface *pasynInterface;
     motorAsynPvt *pPvt;
@@ -272,6 +373,13 @@ static long init_record(struct motorRecord * pmr )
     pPvt->pasynUser = pasynUser;
     pPvt->pmr = pmr;
     pmr->dpvt = pPvt;
+    pPvt->poolLock = epicsMutexMustCreate();
+    pPvt->statusLock = epicsMutexMustCreate();
+    callbackSetCallback(processCallback, &pPvt->processCb);
+    callbackSetPriority(pmr->prio, &pPvt->processCb);
+    callbackSetUser(pPvt, &pPvt->processCb);
+    pPvt->pnext = pvtList;
+    pvtList = pPvt;
 
     status = pasynEpicsUtils->parseLink(pasynUser, &pmr->out,
                                         &port, &signal, &userParam);
@@ -290,6 +398,16 @@ static long init_record(struct motorRecord * pmr )
         goto bad;
     }
 
+    /* Create the message pool, now that the asynUsers can be copied from a connected one */
+    for (i=0; i<MESSAGE_POOL_SIZE; i++) {
+        motorAsynMessage *pmsg = &pPvt->messagePool[i];
+        pmsg->pasynUser = pasynManager->duplicateAsynUser(pasynUser, asynCallback, 0);
+        pmsg->pasynUser->userData = pmsg;
+        pmsg->pooled = 1;
+        pmsg->pnext = pPvt->freeMessages;
+        pPvt->freeMessages = pmsg;
+    }
+
     /* Get the asynInt32 interface */
     pasynInterface = pasynManager->findInterface(pasynUser, asynInt32Type, 1);
     if (!pasynInterface) {
@@ -349,6 +467,12 @@ static long init_record(struct motorRecord * pmr )
     if (findDrvInfo(pmr, pasynUser, motorClosedLoopString,             motorSetClosedLoop)) goto bad;
     if (findDrvInfo(pmr, pasynUser, motorStatusString,                 motorStatus)) goto bad;
     if (findDrvInfo(pmr, pasynUser, motorUpdateStatusString,           motorUpdateStatus)) goto bad;
+
+    /* Drivers based on asynMotorController accept compound moves, older drivers do not */
+    if (pPvt->pasynDrvUser->create(pPvt->asynDrvUserPvt, pasynUser, motorMoveCompoundString, NULL, NULL) == asynSuccess) {
+        pPvt->driverReasons[motorMoveCompound] = pasynUser->reason;
+        pPvt->compoundMove = 1;
+    }
     
     /* Get the asynFloat64Array interface */
     pasynInterface = pasynManager->findInterface(pasynUser,
@@ -481,6 +605,49 @@ CALLBACK_VALUE update_values(struct motorRecord * pmr)
 
 static long start_trans(struct motorRecord * pmr )
 {
+    motorAsynPvt *pPvt = (motorAsynPvt *)pmr->dpvt;
+
+    pPvt->pendingMove.setMask = 0;
+    return(OK);
+}
+
+/* Makes pmsg a compound move, carrying the velocities and acceleration accumulated
+ * since start_trans() with the move (or with MOTOR_MOVE_NONE, just those). */
+static void buildCompoundMove(motorAsynPvt *pPvt, motorAsynMessage *pmsg, int moveCommand, double value)
+{
+    pmsg->command = motorMoveCompound;
+    pmsg->interface = genericPointerType;
+    pmsg->dvalue = value;
+    pmsg->move = pPvt->pendingMove;
+    pmsg->move.command = moveCommand;
+    pmsg->move.value = value;
+    pPvt->pendingMove.setMask = 0;
+}
+
+/* Queues pmsg to the driver */
+static RTN_STATUS queueMessage(struct motorRecord *pmr, motorAsynMessage *pmsg)
+{
+    motorAsynPvt *pPvt = (motorAsynPvt *)pmr->dpvt;
+    asynUser *pasynUser = pmsg->pasynUser;
+    asynStatus status;
+
+    asynPrint(pasynUser, ASYN_TRACE_FLOW,
+        "devAsynMotor::build_trans: calling queueRequest, pmsg=%p, sizeof(*pmsg)=%d"
+        "pmsg->command=%d, pmsg->interface=%d, pmsg->dvalue=%f\n",
+        pmsg, (int)sizeof(*pmsg), pmsg->command, pmsg->interface, pmsg->dvalue);   
+
+    /* Queue asyn request, so we get a callback when driver is ready */
+    pasynUser->reason = pPvt->driverReasons[pmsg->command];
+    /* The driver measures the time the request waits in the queue from this */
+    epicsTimeGetCurrent(&pasynUser->timestamp);
+    status = pasynManager->queueRequest(pasynUser, 0, 0);
+    if (status != asynSuccess) {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR,
+              "devMotorAsyn::build_trans: %s error calling queueRequest, %s\n",
+              pmr->name, pasynUser->errorMessage);
+        freeMessage(pPvt, pmsg);
+        return(ERROR);
+    }
     return(OK);
 }
 
@@ -488,8 +655,6 @@ static RTN_STATUS build_trans( motor_cmnd command,
                    double * param,
                    struct motorRecord * pmr )
 {
-    RTN_STATUS rtnind = OK;
-    asynStatus status;
     motorAsynPvt *pPvt = (motorAsynPvt *)pmr->dpvt;
     asynUser *pasynUser = pPvt->pasynUser;
     motorAsynMessage *pmsg;
@@ -517,6 +682,25 @@ static RTN_STATUS build_trans( motor_cmnd command,
             pPvt->move_cmd = motorHome;
             pPvt->param = 0;
             break;
+        /* With compound moves these are sent with the next move, or by end_trans() */
+        case SET_VEL_BASE:
+            if (pPvt->compoundMove) {
+                pPvt->pendingMove.baseVelocity = *param;
+                pPvt->pendingMove.setMask |= MOTOR_MOVE_SET_VEL_BASE;
+            } else need_call = 1;
+            break;
+        case SET_VELOCITY:
+            if (pPvt->compoundMove) {
+                pPvt->pendingMove.velocity = *param;
+                pPvt->pendingMove.setMask |= MOTOR_MOVE_SET_VELOCITY;
+            } else need_call = 1;
+            break;
+        case SET_ACCEL:
+            if (pPvt->compoundMove) {
+                pPvt->pendingMove.acceleration = *param;
+                pPvt->pendingMove.setMask |= MOTOR_MOVE_SET_ACCEL;
+            } else need_call = 1;
+            break;
         default:
             need_call = 1;
     }
@@ -531,15 +715,9 @@ static RTN_STATUS build_trans( motor_cmnd command,
     if ((pmr->nsta == COMM_ALARM) || (pmr->stat == COMM_ALARM))
         return(ERROR);
 
-   /* Make a copy of asynUser.  This is needed because we can have multiple
-    * requests queued.  It will be freed in the callback */
-    pasynUser = pasynManager->duplicateAsynUser(pasynUser, asynCallback, 0);
-    pmsg = pasynManager->memMalloc(sizeof *pmsg);
-    pmsg->ivalue=0;
-    pmsg->dvalue=0.;
-    pmsg->interface = float64Type;
-    pasynUser->userData = pmsg;
- 
+    /* Get a message and a copy of asynUser.  They will be returned in the callback */
+    pmsg = allocMessage(pPvt);
+
     switch (command) {
         case LOAD_POS:
             pmsg->command = motorPosition;
@@ -561,6 +739,14 @@ static RTN_STATUS build_trans( motor_cmnd command,
         case GO:
             pmsg->command = pPvt->move_cmd;
             pmsg->dvalue = pPvt->param;
+            if (pPvt->compoundMove) {
+                switch (pPvt->move_cmd) {
+                    case motorMoveAbs: buildCompoundMove(pPvt, pmsg, MOTOR_MOVE_ABS,  pPvt->param); break;
+                    case motorMoveRel: buildCompoundMove(pPvt, pmsg, MOTOR_MOVE_REL,  pPvt->param); break;
+                    case motorHome:    buildCompoundMove(pPvt, pmsg, MOTOR_MOVE_HOME, pPvt->param); break;
+                    default: break;
+                }
+            }
             pPvt->move_cmd = -1;
             pPvt->moveRequestPending++;
             /* Do we need to set needUpdate and schedule a process here? */
@@ -577,8 +763,12 @@ static RTN_STATUS build_trans( motor_cmnd command,
             break;
         case JOG:
         case JOG_VELOCITY:
-            pmsg->command = motorMoveVel;
-            pmsg->dvalue = *param;
+            if (pPvt->compoundMove) {
+                buildCompoundMove(pPvt, pmsg, MOTOR_MOVE_VEL, *param);
+            } else {
+                pmsg->command = motorMoveVel;
+                pmsg->dvalue = *param;
+            }
             pPvt->moveRequestPending++;
             break;
         case SET_PGAIN:
@@ -607,6 +797,7 @@ static RTN_STATUS build_trans( motor_cmnd command,
             asynPrint(pasynUser, ASYN_TRACE_ERROR,
                   "devMotorAsyn::build_trans: %s: PRIMITIVE no longer supported\n",
                   pmr->name);
+            freeMessage(pPvt, pmsg);
             return(ERROR);
         case SET_HIGH_LIMIT:
             pmsg->command = motorHighLimit;
@@ -628,29 +819,27 @@ static RTN_STATUS build_trans( motor_cmnd command,
             asynPrint(pasynUser, ASYN_TRACE_ERROR,
                   "devMotorAsyn::build_trans: %s: motor command %d not recognised\n",
                   pmr->name, command);
+            freeMessage(pPvt, pmsg);
             return(ERROR);
     }
 
-    asynPrint(pasynUser, ASYN_TRACE_FLOW,
-        "devAsynMotor::build_trans: calling queueRequest, pmsg=%p, sizeof(*pmsg)=%d"
-        "pmsg->command=%d, pmsg->interface=%d, pmsg->dvalue=%f\n",
-        pmsg, (int)sizeof(*pmsg), pmsg->command, pmsg->interface, pmsg->dvalue);   
-
-    /* Queue asyn request, so we get a callback when driver is ready */
-    pasynUser->reason = pPvt->driverReasons[pmsg->command];
-    status = pasynManager->queueRequest(pasynUser, 0, 0);
-    if (status != asynSuccess) {
-        asynPrint(pasynUser, ASYN_TRACE_ERROR,
-              "devMotorAsyn::build_trans: %s error calling queueRequest, %s\n",
-              pmr->name, pasynUser->errorMessage);
-        rtnind = ERROR;
-    }
-    return(rtnind);
+    return(queueMessage(pmr, pmsg));
 }
 
 static RTN_STATUS end_trans(struct motorRecord * pmr )
 {
-  return(OK);
+    motorAsynPvt *pPvt = (motorAsynPvt *)pmr->dpvt;
+    motorAsynMessage *pmsg;
+
+    /* Send any velocities or acceleration that were not followed by a move */
+    if (!pPvt->pendingMove.setMask) return(OK);
+    if ((pmr->nsta == COMM_ALARM) || (pmr->stat == COMM_ALARM)) {
+        pPvt->pendingMove.setMask = 0;
+        return(ERROR);
+    }
+    pmsg = allocMessage(pPvt);
+    buildCompoundMove(pPvt, pmsg, MOTOR_MOVE_NONE, 0.);
+    return(queueMessage(pmr, pmsg));
 }
 
 /**
@@ -691,6 +880,17 @@ static void asynCallback(asynUser *pasynUser)
                                              pmsg->ivalue);
             break;
 
+        case motorMoveCompound:
+            commandIsMove = (pmsg->move.command != MOTOR_MOVE_NONE);
+            status = pPvt->pasynGenericPointer->write(pPvt->asynGenericPointerPvt, pasynUser,
+                                                      (void *)&pmsg->move);
+            if (status != asynSuccess) {
+                asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                          "devMotorAsyn::asynCallback: %s pasynGenericPointer->write returned %s\n", 
+                          pmr->name, pasynUser->errorMessage);
+            }
+            break;
+
         case motorMoveAbs:
         case motorMoveRel:
         case motorHome:
@@ -728,13 +928,7 @@ static void asynCallback(asynUser *pasynUser)
     else if (pmsg->command == motorPosition)
         pPvt->moveRequestPending = 0;
 
-    pasynManager->memFree(pmsg, sizeof(*pmsg));
-    status = pasynManager->freeAsynUser(pasynUser);
-    if (status != asynSuccess) {
-        asynPrint(pasynUser, ASYN_TRACE_ERROR,
-                  "devMotorAsyn::asynCallback: %s error in freeAsynUser, %s\n",
-                  pmr->name, pasynUser->errorMessage);
-    }
+    freeMessage(pPvt, pmsg);
 }
 
 /**
@@ -754,17 +948,50 @@ static void statusCallback(void *drvPvt, asynUser *pasynUser,
               pPvt->moveRequestPending ? 'P':' ');
 
     if (dbScanLockOK) {
-        dbScanLock((dbCommon *)pmr);
-        memcpy(&pPvt->status, value, sizeof(struct MotorStatus));
-        if (!pPvt->moveRequestPending) {
-        pPvt->needUpdate = 1;
-        /* pmr->rset->process((dbCommon*)pmr); */
-            dbProcess((dbCommon*)pmr);
+        /* Processing the record here would block the driver, which holds its lock, until the
+         * record and anything it links to have processed.  Store the status and process the
+         * record from a callback thread instead.  If that is still pending this status
+         * replaces the previous one, which the record has not seen. */
+        epicsMutexMustLock(pPvt->statusLock);
+        memcpy(&pPvt->latestStatus, value, sizeof(struct MotorStatus));
+        pPvt->statusCallbacks++;
+        if (pPvt->processPending) {
+            pPvt->statusCoalesced++;
+        } else {
+            pPvt->processPending = 1;
+            if (callbackRequest(&pPvt->processCb)) {
+                pPvt->processPending = 0;
+                asynPrint(pasynUser, ASYN_TRACE_ERROR,
+                          "%s devMotorAsyn::statusCallback callbackRequest failed\n",
+                          pmr->name);
+            }
         }
-        dbScanUnlock((dbCommon*)pmr);
+        epicsMutexUnlock(pPvt->statusLock);
     } else {
         memcpy(&pPvt->status, value, sizeof(struct MotorStatus));
         pPvt->needUpdate = 1;
     }
 }
 
+/**
+ * Processes the record with the latest status from statusCallback().
+ */
+static void processCallback(CALLBACK *pcallback)
+{
+    motorAsynPvt *pPvt;
+    motorRecord *pmr;
+
+    callbackGetUser(pPvt, pcallback);
+    pmr = pPvt->pmr;
+
+    dbScanLock((dbCommon *)pmr);
+    epicsMutexMustLock(pPvt->statusLock);
+    memcpy(&pPvt->status, &pPvt->latestStatus, sizeof(struct MotorStatus));
+    pPvt->processPending = 0;
+    epicsMutexUnlock(pPvt->statusLock);
+    if (!pPvt->moveRequestPending) {
+        pPvt->needUpdate = 1;
+        dbProcess((dbCommon*)pmr);
+    }
+    dbScanUnlock((dbCommon*)pmr);
+}
@@ -38,6 +38,7 @@
 #include <epicsString.h>
 #include <epicsTimer.h>
 #include <epicsMutex.h>
+#include <epicsEvent.h>
 #include <errlog.h>
 #include <epicsMessageQueue.h>
 #include <errlog.h>
@@ -149,7 +150,18 @@ static motorCommandStruct motorCommands[] = {
     {motorStatusHomed,          motorStatusHomedString},
 };
 
-typedef enum{typeInt32, typeFloat64, typeFloat64Array} dataType;
+typedef enum{typeInt32, typeFloat64, typeFloat64Array, typeGenericPointer} dataType;
+
+/* Interrupt clients are indexed by these reasons, which are the ones intCallback() can report as changed */
+#define NUM_INDEXED_REASONS (motorMoveToHome + 1)
+#define NUM_STATUS_BITS (motorStatusLast - motorStatusDirection)
+
+/* Entry for an interrupt client in the index of an axis */
+typedef struct {
+    ELLNODE node;
+    interruptNode *pinterruptNode;  /* The node registered with asynManager */
+    int removed;                    /* Cancelled while intCallback() was running, freed when it ends */
+} indexedClient;
 
 struct drvmotorPvt;
 
@@ -164,6 +176,16 @@ typedef struct drvmotorAxisPvt {
     MotorStatus status;
     struct drvmotorPvt *pPvt;
     asynUser *pasynUser;
+    /* Interrupt clients of this axis, so intCallback() does not search all the clients of the port */
+    ELLLIST float64Clients[NUM_INDEXED_REASONS];  /* By reason, called when it changes */
+    ELLLIST statusBitClients[NUM_STATUS_BITS];    /* int32 by status bit, called when it changes */
+    ELLLIST int32Clients;                         /* Other int32 clients, called on every change */
+    ELLLIST genericPointerClients;                /* Called on every change */
+    int callbacksActive;    /* Number of intCallback() calls running for this axis */
+    int removePending;      /* Clients were cancelled while callbacksActive was non-zero */
+    epicsThreadId callbackThread;  /* Thread of the last intCallback() call */
+    int cancelsWaiting;     /* Number of cancel calls waiting for callbacksActive to reach zero */
+    epicsEventId callbacksDone;    /* Signalled when callbacksActive reaches zero with cancelsWaiting set */
 } drvmotorAxisPvt;
 
 typedef struct drvmotorPvt {
@@ -174,6 +196,7 @@ typedef struct drvmotorPvt {
     drvmotorAxisPvt *axisData;
     /* Housekeeping */
     epicsMutexId lock;
+    epicsMutexId intLock;    /* Protects the interrupt client lists of the axes */
     int rebooting;
     epicsMessageQueueId intMsgQId;
     int messagesSent;
@@ -224,7 +247,22 @@ static asynStatus disconnect        (void *drvPvt, asynUser *pasynUser);
 
 /* These are private functions, not used in any interfaces */
 static void intCallback(void *drvPvt, unsigned int num, unsigned int *changed);
+static indexedClient *nextClient(drvmotorPvt *pPvt, ELLLIST *pclientList, indexedClient *pclient);
+static void endCallbacks(drvmotorPvt *pPvt, drvmotorAxisPvt *pAxis);
+static void waitForCallbacks(drvmotorPvt *pPvt, int addr);
 static int config      (drvmotorPvt *pPvt);
+static asynStatus registerInt32Interrupt(void *drvPvt, asynUser *pasynUser,
+                                         interruptCallbackInt32 callback, void *userPvt,
+                                         void **registrarPvt);
+static asynStatus cancelInt32Interrupt(void *drvPvt, asynUser *pasynUser, void *registrarPvt);
+static asynStatus registerFloat64Interrupt(void *drvPvt, asynUser *pasynUser,
+                                           interruptCallbackFloat64 callback, void *userPvt,
+                                           void **registrarPvt);
+static asynStatus cancelFloat64Interrupt(void *drvPvt, asynUser *pasynUser, void *registrarPvt);
+static asynStatus registerGenericPointerInterrupt(void *drvPvt, asynUser *pasynUser,
+                                                  interruptCallbackGenericPointer callback,
+                                                  void *userPvt, void **registrarPvt);
+static asynStatus cancelGenericPointerInterrupt(void *drvPvt, asynUser *pasynUser, void *registrarPvt);
 static int logFunc     (void *userParam,
                         const motorAxisLogMask_t logMask,
                         const char *pFormat, ...);
@@ -276,6 +314,15 @@ static asynDrvUser drvMotorDrvUser = {
 
 static asynUser *defaultAsynUser;
 
+/* The interrupt registration functions filled in by the asyn base interfaces.
+ * drvMotorAsyn wraps these to maintain the per-axis client index. */
+static asynStatus (*baseRegisterInt32)(void *, asynUser *, interruptCallbackInt32, void *, void **);
+static asynStatus (*baseCancelInt32)(void *, asynUser *, void *);
+static asynStatus (*baseRegisterFloat64)(void *, asynUser *, interruptCallbackFloat64, void *, void **);
+static asynStatus (*baseCancelFloat64)(void *, asynUser *, void *);
+static asynStatus (*baseRegisterGenericPointer)(void *, asynUser *, interruptCallbackGenericPointer, void *, void **);
+static asynStatus (*baseCancelGenericPointer)(void *, asynUser *, void *);
+
 
 int drvAsynMotorConfigure(const char *portName, const char *driverName,
               int card, int num_axes)
@@ -283,7 +330,7 @@ int drvAsynMotorConfigure(const char *portName, const char *driverName,
     drvmotorPvt *pPvt;
     drvmotorAxisPvt *pAxis;
     asynStatus status;
-    int i;
+    int i, j;
 
     pPvt = callocMustSucceed(1, sizeof(*pPvt), "drvAsynMotorConfigure");
     pPvt->portName = epicsStrDup(portName);
@@ -338,6 +385,12 @@ int drvAsynMotorConfigure(const char *portName, const char *driverName,
     }
     pasynManager->registerInterruptSource(portName, &pPvt->int32,
                                           &pPvt->int32InterruptPvt);
+    if (!baseRegisterInt32) {
+        baseRegisterInt32 = drvMotorInt32.registerInterruptUser;
+        baseCancelInt32 = drvMotorInt32.cancelInterruptUser;
+        drvMotorInt32.registerInterruptUser = registerInt32Interrupt;
+        drvMotorInt32.cancelInterruptUser = cancelInt32Interrupt;
+    }
 
     status = pasynUInt32DigitalBase->initialize(pPvt->portName,&pPvt->uint32digital);
     if (status != asynSuccess) {
@@ -354,6 +407,12 @@ int drvAsynMotorConfigure(const char *portName, const char *driverName,
     }
     pasynManager->registerInterruptSource(portName, &pPvt->float64,
                                           &pPvt->float64InterruptPvt);
+    if (!baseRegisterFloat64) {
+        baseRegisterFloat64 = drvMotorFloat64.registerInterruptUser;
+        baseCancelFloat64 = drvMotorFloat64.cancelInterruptUser;
+        drvMotorFloat64.registerInterruptUser = registerFloat64Interrupt;
+        drvMotorFloat64.cancelInterruptUser = cancelFloat64Interrupt;
+    }
 
     status = pasynFloat64ArrayBase->initialize(pPvt->portName,&pPvt->float64Array);
     if (status != asynSuccess) {
@@ -368,6 +427,12 @@ int drvAsynMotorConfigure(const char *portName, const char *driverName,
     }
     pasynManager->registerInterruptSource(portName, &pPvt->genericPointer,
                                           &pPvt->genericPointerInterruptPvt);
+    if (!baseRegisterGenericPointer) {
+        baseRegisterGenericPointer = drvMotorGenericPointer.registerInterruptUser;
+        baseCancelGenericPointer = drvMotorGenericPointer.cancelInterruptUser;
+        drvMotorGenericPointer.registerInterruptUser = registerGenericPointerInterrupt;
+        drvMotorGenericPointer.cancelInterruptUser = cancelGenericPointerInterrupt;
+    }
 
     status = pasynManager->registerInterface(pPvt->portName,&pPvt->drvUser);
     if (status != asynSuccess) {
@@ -385,6 +450,7 @@ int drvAsynMotorConfigure(const char *portName, const char *driverName,
     }
 
     pPvt->lock = epicsMutexCreate();
+    pPvt->intLock = epicsMutexMustCreate();
     pPvt->card = card;
     config(pPvt);
 
@@ -400,6 +466,11 @@ int drvAsynMotorConfigure(const char *portName, const char *driverName,
         }
         pAxis->num = i;
         pAxis->pPvt = pPvt;
+        for (j = 0; j < NUM_INDEXED_REASONS; j++) ellInit(&pAxis->float64Clients[j]);
+        for (j = 0; j < NUM_STATUS_BITS; j++) ellInit(&pAxis->statusBitClients[j]);
+        ellInit(&pAxis->int32Clients);
+        ellInit(&pAxis->genericPointerClients);
+        pAxis->callbacksDone = epicsEventMustCreate(epicsEventEmpty);
             /* Create asynUser for debugging */
             pAxis->pasynUser = pasynManager->createAsynUser(0, 0);
             /* Connect to device */
@@ -830,14 +901,14 @@ static void intCallback(void *axisPvt, unsigned int nChanged,
 {
     drvmotorAxisPvt *pAxis = (drvmotorAxisPvt *)axisPvt;
     drvmotorPvt *pPvt = pAxis->pPvt;
-    int addr;
     unsigned int reason;
+    indexedClient *pclient;
     ELLLIST *pclientList;
-    interruptNode *pnode;
     int ivalue;
     double dvalue;
     unsigned int i, bit_num;
     epicsInt32 changedmask = 0;
+    int statusValues[NUM_STATUS_BITS];
 
     /* We are called back with an array of things that have changed.
        First put these into a single int32 word for passing up to higher layers
@@ -850,6 +921,7 @@ static void intCallback(void *axisPvt, unsigned int nChanged,
             changedmask |= (1 << bit_num);
             (*pPvt->drvset->getInteger)(pAxis->axis, changed[i], &ivalue);
             BIT_SET(bit_num, &(pAxis->status.status), ivalue);
+            statusValues[bit_num] = ivalue;
         }
         if (changed[i] == motorPosition) {
             (*pPvt->drvset->getDouble)(pAxis->axis, changed[i], 
@@ -865,80 +937,291 @@ static void intCallback(void *axisPvt, unsigned int nChanged,
         }
     }
 
-    /* Pass float64 interrupts */
-    pasynManager->interruptStart(pPvt->float64InterruptPvt, &pclientList);
-    pnode = (interruptNode *)ellFirst(pclientList);
-    while (pnode) {
-        asynFloat64Interrupt *pfloat64Interrupt = pnode->drvPvt;
-        addr = pfloat64Interrupt->addr;
-        reason = pfloat64Interrupt->pasynUser->reason;
-        if (addr == pAxis->num) {
-            for (i = 0; i < nChanged; i++) {
-                if (changed[i] == reason) {
-                    (*pPvt->drvset->getDouble)(pAxis->axis, changed[i], &dvalue);
-                    pfloat64Interrupt->callback(pfloat64Interrupt->userPvt, 
-                                pfloat64Interrupt->pasynUser,
-                                dvalue);
-                }
-            }
+    /* The client callbacks are called without intLock held, because they can take other locks.
+     * Clients cancelled meanwhile are only marked as removed, and are freed by endCallbacks(). */
+    epicsMutexMustLock(pPvt->intLock);
+    pAxis->callbacksActive++;
+    pAxis->callbackThread = epicsThreadGetIdSelf();
+    epicsMutexUnlock(pPvt->intLock);
+
+    /* Pass float64 interrupts to the clients of each changed parameter */
+    for (i = 0; i < nChanged; i++) {
+        if (changed[i] >= NUM_INDEXED_REASONS) continue;
+        pclientList = &pAxis->float64Clients[changed[i]];
+        pclient = nextClient(pPvt, pclientList, NULL);
+        if (!pclient) continue;
+        (*pPvt->drvset->getDouble)(pAxis->axis, changed[i], &dvalue);
+        for (; pclient; pclient = nextClient(pPvt, pclientList, pclient)) {
+            asynFloat64Interrupt *pfloat64Interrupt = pclient->pinterruptNode->drvPvt;
+            pfloat64Interrupt->callback(pfloat64Interrupt->userPvt, 
+                                        pfloat64Interrupt->pasynUser,
+                                        dvalue);
         }
-        pnode = (interruptNode *)ellNext(&pnode->node);
     }
-    pasynManager->interruptEnd(pPvt->float64InterruptPvt);
 
     /* Pass motorStatus interrupts */
-    pasynManager->interruptStart(pPvt->genericPointerInterruptPvt, &pclientList);
-    pnode = (interruptNode *)ellFirst(pclientList);
-    while (pnode) {
-        asynGenericPointerInterrupt *pInterrupt = pnode->drvPvt;
-        addr = pInterrupt->addr;
-        reason = pInterrupt->pasynUser->reason;
-        if (addr == pAxis->num) {
-            pInterrupt->callback(pInterrupt->userPvt, 
-                            pInterrupt->pasynUser,
-                            (void *)&pAxis->status);
+    pclientList = &pAxis->genericPointerClients;
+    for (pclient = nextClient(pPvt, pclientList, NULL); pclient;
+         pclient = nextClient(pPvt, pclientList, pclient)) {
+        asynGenericPointerInterrupt *pInterrupt = pclient->pinterruptNode->drvPvt;
+        pInterrupt->callback(pInterrupt->userPvt, 
+                             pInterrupt->pasynUser,
+                             (void *)&pAxis->status);
+    }
+
+    /* Pass int32 interrupts for the status bits that changed */
+    for (bit_num = 0; bit_num < NUM_STATUS_BITS; bit_num++) {
+        if (!BIT_ISSET(bit_num, 1, &changedmask)) continue;
+        pclientList = &pAxis->statusBitClients[bit_num];
+        for (pclient = nextClient(pPvt, pclientList, NULL); pclient;
+             pclient = nextClient(pPvt, pclientList, pclient)) {
+            asynInt32Interrupt *pint32Interrupt = pclient->pinterruptNode->drvPvt;
+            pint32Interrupt->callback(pint32Interrupt->userPvt, 
+                                      pint32Interrupt->pasynUser,
+                                      statusValues[bit_num]);
         }
-        pnode = (interruptNode *)ellNext(&pnode->node);
     }
-    pasynManager->interruptEnd(pPvt->genericPointerInterruptPvt);
-
-    /* Pass int32 interrupts */
-    pasynManager->interruptStart(pPvt->int32InterruptPvt, &pclientList);
-    pnode = (interruptNode *)ellFirst(pclientList);
-    while (pnode) {
-        asynInt32Interrupt *pint32Interrupt = pnode->drvPvt;
-        addr = pint32Interrupt->addr;
+
+    /* Pass the other int32 interrupts */
+    pclientList = &pAxis->int32Clients;
+    for (pclient = nextClient(pPvt, pclientList, NULL); pclient;
+         pclient = nextClient(pPvt, pclientList, pclient)) {
+        asynInt32Interrupt *pint32Interrupt = pclient->pinterruptNode->drvPvt;
         reason = pint32Interrupt->pasynUser->reason;
-        if (addr == pAxis->num) {
-            if ( reason >= motorStatusDirection && 
-             reason < motorStatusLast ) {
-                if (BIT_ISSET(reason - motorStatusDirection, 1, &changedmask))
-                {
-                    (*pPvt->drvset->getInteger)(pAxis->axis, reason, &ivalue);
-                    pint32Interrupt->callback(pint32Interrupt->userPvt, 
+        /* If we've subscribed to the aggregate status */
+        if (reason == motorStatus) {
+            ivalue = pAxis->status.status;
+        } else {
+            (*pPvt->drvset->getInteger)(pAxis->axis, reason, &ivalue);
+        }
+        pint32Interrupt->callback(pint32Interrupt->userPvt, 
                                   pint32Interrupt->pasynUser,
                                   ivalue);
-                }
-            }
-            /* If we've subscribed to the aggregate status */
-            else if (reason == motorStatus) {
-                pint32Interrupt->callback(pint32Interrupt->userPvt,
-                          pint32Interrupt->pasynUser,
-                          pAxis->status.status);
-            }
-            else {
-                (*pPvt->drvset->getInteger)(pAxis->axis, reason, &ivalue);
-                          pint32Interrupt->callback(pint32Interrupt->userPvt, 
-                          pint32Interrupt->pasynUser,
-                          ivalue);
+    }
+
+    endCallbacks(pPvt, pAxis);
+}
+
+/* Returns the client after pclient in a client list, or the first one if pclient is NULL,
+ * skipping clients that have been cancelled */
+static indexedClient *nextClient(drvmotorPvt *pPvt, ELLLIST *pclientList, indexedClient *pclient)
+{
+    epicsMutexMustLock(pPvt->intLock);
+    pclient = pclient ? (indexedClient *)ellNext(&pclient->node) : (indexedClient *)ellFirst(pclientList);
+    while (pclient && pclient->removed)
+        pclient = (indexedClient *)ellNext(&pclient->node);
+    epicsMutexUnlock(pPvt->intLock);
+    return(pclient);
+}
+
+/* Frees the clients of a list that were cancelled while intCallback() was running.
+ * Called with intLock held. */
+static void freeRemovedClients(ELLLIST *pclientList)
+{
+    indexedClient *pclient, *pnext;
+
+    for (pclient = (indexedClient *)ellFirst(pclientList); pclient; pclient = pnext) {
+        pnext = (indexedClient *)ellNext(&pclient->node);
+        if (pclient->removed) {
+            ellDelete(pclientList, &pclient->node);
+            free(pclient);
+        }
+    }
+}
+
+/* Ends the client callbacks of intCallback().  Once no intCallback() is running for the axis
+ * the clients cancelled during them are freed and waitForCallbacks() is woken up. */
+static void endCallbacks(drvmotorPvt *pPvt, drvmotorAxisPvt *pAxis)
+{
+    int i;
+
+    epicsMutexMustLock(pPvt->intLock);
+    if ((--pAxis->callbacksActive == 0) && pAxis->removePending) {
+        for (i = 0; i < NUM_INDEXED_REASONS; i++)
+            freeRemovedClients(&pAxis->float64Clients[i]);
+        for (i = 0; i < NUM_STATUS_BITS; i++)
+            freeRemovedClients(&pAxis->statusBitClients[i]);
+        freeRemovedClients(&pAxis->int32Clients);
+        freeRemovedClients(&pAxis->genericPointerClients);
+        pAxis->removePending = 0;
+    }
+    if ((pAxis->callbacksActive == 0) && pAxis->cancelsWaiting)
+        epicsEventSignal(pAxis->callbacksDone);
+    epicsMutexUnlock(pPvt->intLock);
+}
+
+/* Waits until no intCallback() is running for an axis, so that the interrupt node of a
+ * cancelled client can be freed by the base cancel method.  Must not be called with intLock held.
+ * A client that cancels itself from its own callback does not wait, because that would never end;
+ * intCallback() does not use the interrupt node again after the callback returns. */
+static void waitForCallbacks(drvmotorPvt *pPvt, int addr)
+{
+    drvmotorAxisPvt *pAxis;
+
+    if ((addr < 0) || (addr >= pPvt->numAxes)) return;
+    pAxis = &pPvt->axisData[addr];
+    epicsMutexMustLock(pPvt->intLock);
+    if (pAxis->callbacksActive && (pAxis->callbackThread != epicsThreadGetIdSelf())) {
+        pAxis->cancelsWaiting++;
+        while (pAxis->callbacksActive) {
+            epicsMutexUnlock(pPvt->intLock);
+            epicsEventMustWait(pAxis->callbacksDone);
+            epicsMutexMustLock(pPvt->intLock);
+        }
+        /* An epicsEvent wakes up one waiter, so pass the signal on to the next one */
+        if (--pAxis->cancelsWaiting)
+            epicsEventSignal(pAxis->callbacksDone);
+    }
+    epicsMutexUnlock(pPvt->intLock);
+}
+
+/* Returns the list of the axis index that an interrupt client belongs in, or NULL
+ * if intCallback() never calls it */
+static ELLLIST *findClientList(drvmotorPvt *pPvt, dataType type, int addr, int reason)
+{
+    drvmotorAxisPvt *pAxis;
+
+    if ((addr < 0) || (addr >= pPvt->numAxes)) return(NULL);
+    pAxis = &pPvt->axisData[addr];
+    switch (type) {
+        case typeFloat64:
+            if ((reason < 0) || (reason >= NUM_INDEXED_REASONS)) return(NULL);
+            return(&pAxis->float64Clients[reason]);
+        case typeInt32:
+            if ((reason >= motorStatusDirection) && (reason < motorStatusLast))
+                return(&pAxis->statusBitClients[reason - motorStatusDirection]);
+            return(&pAxis->int32Clients);
+        default:
+            return(&pAxis->genericPointerClients);
+    }
+}
+
+static void addClient(drvmotorPvt *pPvt, dataType type, int addr, int reason,
+                      interruptNode *pinterruptNode)
+{
+    ELLLIST *pclientList = findClientList(pPvt, type, addr, reason);
+    indexedClient *pclient;
+
+    if (!pclientList) return;
+    pclient = callocMustSucceed(1, sizeof(*pclient), "drvMotorAsyn::addClient");
+    pclient->pinterruptNode = pinterruptNode;
+    epicsMutexMustLock(pPvt->intLock);
+    ellAdd(pclientList, &pclient->node);
+    epicsMutexUnlock(pPvt->intLock);
+}
+
+static void removeClient(drvmotorPvt *pPvt, dataType type, int addr, int reason,
+                         interruptNode *pinterruptNode)
+{
+    ELLLIST *pclientList = findClientList(pPvt, type, addr, reason);
+    drvmotorAxisPvt *pAxis;
+    indexedClient *pclient;
+
+    if (!pclientList) return;
+    pAxis = &pPvt->axisData[addr];
+    epicsMutexMustLock(pPvt->intLock);
+    for (pclient = (indexedClient *)ellFirst(pclientList); pclient;
+         pclient = (indexedClient *)ellNext(&pclient->node)) {
+        if ((pclient->pinterruptNode == pinterruptNode) && !pclient->removed) {
+            if (pAxis->callbacksActive) {
+                /* intCallback() may be using this client, so endCallbacks() frees it */
+                pclient->removed = 1;
+                pAxis->removePending = 1;
+            } else {
+                ellDelete(pclientList, &pclient->node);
+                free(pclient);
             }
+            break;
         }
-        pnode = (interruptNode *)ellNext(&pnode->node);
     }
-    pasynManager->interruptEnd(pPvt->int32InterruptPvt);
+    epicsMutexUnlock(pPvt->intLock);
 }
 
-
+static asynStatus registerInt32Interrupt(void *drvPvt, asynUser *pasynUser,
+                                         interruptCallbackInt32 callback, void *userPvt,
+                                         void **registrarPvt)
+{
+    interruptNode *pinterruptNode;
+    asynInt32Interrupt *pInterrupt;
+    asynStatus status;
+
+    status = baseRegisterInt32(drvPvt, pasynUser, callback, userPvt, registrarPvt);
+    if (status != asynSuccess) return(status);
+    pinterruptNode = (interruptNode *)*registrarPvt;
+    pInterrupt = pinterruptNode->drvPvt;
+    addClient((drvmotorPvt *)drvPvt, typeInt32, pInterrupt->addr, pInterrupt->pasynUser->reason,
+              pinterruptNode);
+    return(asynSuccess);
+}
+
+static asynStatus cancelInt32Interrupt(void *drvPvt, asynUser *pasynUser, void *registrarPvt)
+{
+    interruptNode *pinterruptNode = (interruptNode *)registrarPvt;
+    asynInt32Interrupt *pInterrupt = pinterruptNode->drvPvt;
+
+    removeClient((drvmotorPvt *)drvPvt, typeInt32, pInterrupt->addr, pInterrupt->pasynUser->reason,
+                 pinterruptNode);
+    waitForCallbacks((drvmotorPvt *)drvPvt, pInterrupt->addr);
+    return(baseCancelInt32(drvPvt, pasynUser, registrarPvt));
+}
+
+static asynStatus registerFloat64Interrupt(void *drvPvt, asynUser *pasynUser,
+                                           interruptCallbackFloat64 callback, void *userPvt,
+                                           void **registrarPvt)
+{
+    interruptNode *pinterruptNode;
+    asynFloat64Interrupt *pInterrupt;
+    asynStatus status;
+
+    status = baseRegisterFloat64(drvPvt, pasynUser, callback, userPvt, registrarPvt);
+    if (status != asynSuccess) return(status);
+    pinterruptNode = (interruptNode *)*registrarPvt;
+    pInterrupt = pinterruptNode->drvPvt;
+    addClient((drvmotorPvt *)drvPvt, typeFloat64, pInterrupt->addr, pInterrupt->pasynUser->reason,
+              pinterruptNode);
+    return(asynSuccess);
+}
+
+static asynStatus cancelFloat64Interrupt(void *drvPvt, asynUser *pasynUser, void *registrarPvt)
+{
+    interruptNode *pinterruptNode = (interruptNode *)registrarPvt;
+    asynFloat64Interrupt *pInterrupt = pinterruptNode->drvPvt;
+
+    removeClient((drvmotorPvt *)drvPvt, typeFloat64, pInterrupt->addr, pInterrupt->pasynUser->reason,
+                 pinterruptNode);
+    waitForCallbacks((drvmotorPvt *)drvPvt, pInterrupt->addr);
+    return(baseCancelFloat64(drvPvt, pasynUser, registrarPvt));
+}
+
+static asynStatus registerGenericPointerInterrupt(void *drvPvt, asynUser *pasynUser,
+                                                  interruptCallbackGenericPointer callback,
+                                                  void *userPvt, void **registrarPvt)
+{
+    interruptNode *pinterruptNode;
+    asynGenericPointerInterrupt *pInterrupt;
+    asynStatus status;
+
+    status = baseRegisterGenericPointer(drvPvt, pasynUser, callback, userPvt, registrarPvt);
+    if (status != asynSuccess) return(status);
+    pinterruptNode = (interruptNode *)*registrarPvt;
+    pInterrupt = pinterruptNode->drvPvt;
+    addClient((drvmotorPvt *)drvPvt, typeGenericPointer, pInterrupt->addr, pInterrupt->pasynUser->reason,
+              pinterruptNode);
+    return(asynSuccess);
+}
+
+static asynStatus cancelGenericPointerInterrupt(void *drvPvt, asynUser *pasynUser, void *registrarPvt)
+{
+    interruptNode *pinterruptNode = (interruptNode *)registrarPvt;
+    asynGenericPointerInterrupt *pInterrupt = pinterruptNode->drvPvt;
+
+    removeClient((drvmotorPvt *)drvPvt, typeGenericPointer, pInterrupt->addr, pInterrupt->pasynUser->reason,
+                 pinterruptNode);
+    waitForCallbacks((drvmotorPvt *)drvPvt, pInterrupt->addr);
+    return(baseCancelGenericPointer(drvPvt, pasynUser, registrarPvt));
+}
+
+
 /*static void rebootCallback(void *drvPvt)*/
 /*{*/
 /*   drvmotorPvt *pPvt = (drvmotorPvt *)drvPvt;*/
@@ -48,19 +48,39 @@ USAGE...        This file contains driver functions that are common
  *                  messages.
  * .07 11/30/12 rls In process_messages(), pass commanded velocity from
  *                  motor_info->velocity to node->velocity with INFO request.
+ * .08 The message queue is lock-free; mess_nodes come from a preallocated
+ *                  pool for each driver_table (see motor_malloc()).
+ * .09 The cards in motion are kept in a bitmap and a list of active cards
+ *                  instead of bits in an int, so there is no limit of 32
+ *                  cards; motor_task() polls each card at its own rate.
+ * .10 Optional worker thread for each card (motorDrvComCardThreads) of the
+ *                  drivers that set driver_table card_threads, so a slow
+ *                  card does not delay the status of the others.
+ * .11 INFO requests within the stale data delay are parked until it has
+ *                  passed instead of sleeping in process_message().
+ * .12 Consecutive commands for one card are sent as one line by drivers
+ *                  that provide driver_table coalesce().
+ * .13 Optional timing of the driver hooks per card and of the message
+ *                  queue (motorDrvComTiming).
+ * .14 At most one status callback per axis is queued by query_axis(); newer
+ *                  status updates are merged into it (see post_status()).
  */
 
 
 #include        <stdlib.h>
 #include        <string.h>
 #include        <callback.h>
+#include        <cantProceed.h>
 #include        <epicsThread.h>
 #include        <epicsExport.h>
 #include        <epicsAtomic.h>
 #include        <epicsExit.h>
 #include        <epicsMutex.h>
 #include        <ellLib.h>
+#include        <iocsh.h>
+#include        <epicsStdio.h>
 #include        <stdarg.h>
+#include        <stdio.h>
 
 #include        "motor.h"
 
@@ -83,11 +103,35 @@ static inline void Debug(int level, const char *format, ...) {
   #endif
 }
 
+struct card_worker;
+struct cmnd_batch;
+struct call_stats;
+
 /* Function declarations. */
-static double query_axis(int, struct driver_table *, epicsTime, double);
+static double query_axis(int, struct driver_table *, epicsTime, double, struct card_worker *);
 static void process_messages(struct driver_table *, epicsTime, double);
+static void process_message(struct driver_table *, struct mess_node *, epicsTime, double,
+                            struct card_worker *);
+static void mark_in_motion(struct driver_table *, struct card_worker *, int, epicsTime);
+static double parked_wait(struct mess_node *, epicsTime, double);
+static void process_parked(struct driver_table *, struct mess_node **, epicsTime, double,
+                           struct card_worker *);
+static void start_card_workers(struct driver_table *, double);
+static void send_command(struct driver_table *, struct cmnd_batch *, int, const char *, const char *);
+static void flush_commands(struct driver_table *, struct cmnd_batch *);
+static RTN_STATUS timed_sendmsg(struct driver_table *, int, const char *, const char *);
+static int timed_getmsg(struct driver_table *, int, char *, int);
+static int timed_setstat(struct driver_table *, int, int);
+static void timed_strtstat(struct driver_table *, int);
+static void add_call_time(struct call_stats *, epicsUInt64);
+static epicsUInt64 monotonic_ns(void);
+static void post_status(struct driver_table *, int, int, struct mess_node *);
 static struct mess_node *get_head_node(struct driver_table *);
-static struct mess_node *motor_malloc(struct circ_queue *, epicsEvent *);
+static struct mess_node *motor_malloc(struct driver_table *);
+static struct motordrvComPvt *get_com_pvt(struct driver_table *);
+static void set_card_in_motion(struct motordrvComPvt *, int, epicsTime);
+static void clear_card_in_motion(struct motordrvComPvt *, int);
+static void count_moving(struct motordrvComPvt *, int);
 
 static epicsInt32 motorShutdown = 0;
 static epicsThreadOnceId motorShutdownOnce = EPICS_THREAD_ONCE_INIT;
@@ -99,6 +143,146 @@ typedef struct motorWakeNode {
     epicsEvent *ev;
 } motorWakeNode;
 
+/* Poll state of one card. */
+struct card_poll
+{
+    double period;              /* Poll period used while the card is in motion. */
+    epicsTime next_poll;        /* When motor_task() polls the card next. */
+    int active_index;           /* Index in active_cards, -1 when not in motion. */
+};
+
+/*
+ * The status callback of one axis queued by query_axis() that has not run
+ * yet.  The node's callback user points to the slot while it is queued.
+ */
+struct status_slot
+{
+    struct motordrvComPvt *pvt;
+    struct mess_node *node;     /* The queued node, NULL if none. */
+    void (*callback) (CALLBACK *);      /* The node's own callback function and user. */
+    void *user;
+};
+
+/* Timing statistics of one driver hook, or of the message queue; in ns. */
+struct call_stats
+{
+    unsigned long count;
+    epicsUInt64 min;
+    epicsUInt64 max;
+    epicsUInt64 sum;
+};
+
+/* The driver hooks that are timed. */
+enum timed_hooks {HOOK_SENDMSG, HOOK_GETMSG, HOOK_SETSTAT, HOOK_STRTSTAT, NUM_HOOKS};
+static const char *hookNames[NUM_HOOKS] = {"sendmsg", "getmsg", "setstat", "strtstat"};
+
+/*
+ * Commands for one card that have not been sent yet; see send_command().
+ * Only used when the driver provides coalesce().
+ */
+struct cmnd_batch
+{
+    int card;
+    int count;                  /* Number of commands, 0 if none. */
+    char first[MAX_MSG_SIZE];   /* The first command, sent as is if it stays alone. */
+    const char *first_axis;
+    char *line;                 /* The coalesced line, coalesce_len + 1 bytes. */
+};
+
+/*
+ * Worker thread of one card, used instead of motor_task() for the messages
+ * and status queries of the card when motorDrvComCardThreads is enabled and
+ * the driver sets driver_table card_threads.
+ * Except for the message queue, the fields are only accessed by the worker.
+ */
+struct card_worker
+{
+    struct driver_table *tabptr;
+    int card;
+    epicsEvent *event;          /* Signalled when a message is queued, and on IOC shutdown. */
+    epicsMutexId lock;          /* Protects head and tail. */
+    struct mess_node *head;     /* Messages for this card, oldest first. */
+    struct mess_node *tail;
+    bool moving;                /* The card has motors in motion. */
+    double period;              /* Poll period while moving. */
+    epicsTime next_poll;
+    double max_delay;           /* Stale data delay, as in motor_task(). */
+    struct mess_node *parked;   /* Parked INFO requests, earliest info_due first. */
+    struct cmnd_batch batch;
+};
+
+/* State of a driver_table that is private to motordrvCom. */
+struct motordrvComPvt
+{
+    ELLNODE node;               /* In poolList, for motorDrvComReport(). */
+    struct driver_table *tabptr;
+    epicsMutexId lock;
+    char *block;                /* The preallocated nodes. */
+    size_t stride;              /* Node size rounded up to a cache line. */
+    int size;                   /* Number of nodes in block. */
+    struct mess_node *free_list;
+    int in_use;                 /* Nodes allocated, from the pool or the heap. */
+    int high_water;             /* Maximum of in_use. */
+    unsigned long exhausted;    /* Nodes allocated from the heap because the pool was empty. */
+
+    /* Cards in motion; only accessed by motor_task(). */
+    int num_cards;              /* Number of cards in cards[], active_cards[] and inmotion_map. */
+    struct card_poll *cards;
+    epicsUInt32 *inmotion_map;  /* One bit per card in motion. */
+    int *active_cards;          /* The cards in motion, in no particular order. */
+    int num_active;
+    int num_moving;             /* Cards in motion, here and in the workers; protected by lock. */
+    double scan_sec;            /* Default poll period, from motor_task(). */
+
+    /* Poll periods set by motor_card_scan_rate(), 0 for the default; protected by lock. */
+    int num_scan_secs;
+    double *card_scan_sec;
+
+    /* Worker threads of cards 0 to num_workers - 1, NULL without card threads. */
+    int num_workers;
+    struct card_worker *workers;
+
+    struct mess_node *parked;   /* INFO requests parked by motor_task(), earliest info_due first. */
+    struct cmnd_batch batch;    /* Commands not yet sent by motor_task(). */
+
+    /* INFO requests parked instead of sleeping; protected by lock. */
+    unsigned long info_parked;
+    double sleep_avoided;       /* Total time that would have been slept, in seconds. */
+    double report_sleep_avoided;/* sleep_avoided at the last motorDrvComReport(). */
+    epicsTime report_time;      /* Time of the last motorDrvComReport(), or of creation. */
+
+    /* Coalesced command lines; protected by lock. */
+    unsigned long coalesced_lines;
+    unsigned long coalesced_cmnds;
+
+    /* Hook timing while motorDrvComTiming is enabled; protected by lock.
+     * hook_stats[0] is for calls with ALL_CARDS, hook_stats[card + 1] for
+     * each card. */
+    int num_hook_stats;
+    struct call_stats (*hook_stats)[NUM_HOOKS];
+    struct call_stats queue_wait;       /* Time from motor_send() to motor_task(). */
+    int queue_depth;                    /* Messages in queptr; atomic. */
+    int max_queue_depth;                /* Largest queue_depth; atomic. */
+
+    /* Queued status callbacks of each axis, status_slots[card][axis]; protected by lock. */
+    int num_status_slots;
+    struct status_slot **status_slots;
+    unsigned long status_callbacks;     /* Status callbacks queued. */
+    unsigned long status_coalesced;     /* Status updates merged into a queued callback. */
+};
+
+#define MAP_BIT(card)   ((epicsUInt32) 1 << ((card) % 32))
+#define MAP_WORD(card)  ((card) / 32)
+
+#define NODE_ALIGN 64           /* Cache line size for pool nodes. */
+
+static int poolSize = 100;      /* Size of pools created from now on; see motorDrvComPoolSize(). */
+static int cardThreads = 0;     /* Start a thread per card of drivers that support it; see motorDrvComCardThreads(). */
+static int timingEnabled = 0;   /* Time the driver hooks; see motorDrvComTiming(). */
+static epicsThreadOnceId poolOnce = EPICS_THREAD_ONCE_INIT;
+static epicsMutexId poolListLock = 0;
+static ELLLIST poolList;
+
 static void motorAtExit(void *arg)
 {
     epicsAtomicSetIntT(&motorShutdown, 1u);
@@ -132,42 +316,53 @@ static void motorShutdownEnsureInit(void)
     epicsThreadOnce(&motorShutdownOnce, motorShutdownInitOnce, NULL);
 }
 
+/* Register an event to be signalled on IOC shutdown, to wake its wait(). */
+static void motorShutdownAddWake(epicsEvent *ev)
+{
+    if (motorShutdownLock && ev)
+    {
+        motorWakeNode *wn = (motorWakeNode*)calloc(1, sizeof(*wn));
+        if (wn)
+        {
+            wn->ev = ev;
+            epicsMutexLock(motorShutdownLock);
+            ellAdd(&motorShutdownWakeList, &wn->node);
+            epicsMutexUnlock(motorShutdownLock);
+        }
+    }
+}
+
 /*
  * FUNCION...   motor_task()
  * LOGIC:
  *  WHILE FOREVER
- *      IF no motors in motion for this board type.
+ *      IF no cards in the active (in motion) list.
  *          Set "wait_time" to WAIT_FOREVER.
- *      ELSE IF stale data timer is active (stale_data_delay != 0).
- *          Set "wait_time" to the remaining stale data time.
- *          Clear stale data timer active indicator (stale_data_delay = 0).
  *      ELSE
  *          Update current_time.
- *          Set "time_lapse" to time elapsed (in seconds) since last update.
- *          IF elapsed time (time_lapse) < user delay (scan_sec).
- *              Set "wait_time" to (user delay - elapsed time).
- *              IF "wait_time" < 1/2 quantum time unit.
- *                  Set "wait_time" to zero.
- *              ENDIF
- *          ELSE
+ *          Set "wait_time" to the time until the earliest "next_poll" of the
+ *              active cards.
+ *          IF "wait_time" < 1/2 quantum time unit.
  *              Set "wait_time" to zero.
  *          ENDIF
  *      ENDIF
+ *      Limit "wait_time" to the time until the earliest parked INFO request.
  *      IF wait_time nonzero.
  *          Pend on semaphore with "wait_time" timeout argument.
  *      ENDIF
  *      Update "previous_time".
- *      IF the "any_motor_in_motion" indicator is true.
- *          IF VME58 instance of this task.
+ *      FOR each active card whose "next_poll" is due.
+ *          IF first card due AND VME58 instance of this task.
  *              Start data area update on all cards - Call start_status().
  *          ENDIF
- *          FOR each OMS board.
- *              IF motor data structure defined, AND, motor-in-motion indicator true.
- *                  Update OMS board status - call query_axis().
- *              ENDIF
- *          ENDFOR
- *      ENDIF
+ *          Update board status - call query_axis().
+ *          IF card still active.
+ *              Set "next_poll" to the stale data delay returned by
+ *                  query_axis() or, if zero, to the card's poll period.
+ *          ENDIF
+ *      ENDFOR
  *      Process commands - call process_messages().
+ *      Process the parked INFO requests that are due - call process_parked().
  *  ENDWHILE
  *
  * NOTES... This function MUST BE reentrant.
@@ -177,32 +372,24 @@ static void motorShutdownEnsureInit(void)
 epicsShareFunc int motor_task(struct thread_args *args)
 {
     struct driver_table *tabptr;
+    struct motordrvComPvt *pvt;
     bool sem_ret;
     epicsTime previous_time, current_time;
-    double scan_sec, wait_time, time_lapse, stale_data_max_delay, stale_data_delay = 0.0;
+    double wait_time, stale_data_max_delay, stale_data_delay;
     const double quantum = epicsThreadSleepQuantum();
     double half_quantum;
     int itera;
 
     tabptr = args->table;    
     previous_time = epicsTime::getCurrent();
-    scan_sec = 1 / (double) args->motor_scan_rate;      /* Convert HZ to seconds. */
+    pvt = get_com_pvt(tabptr);
+    pvt->scan_sec = 1 / (double) args->motor_scan_rate;      /* Convert HZ to seconds. */
     
     /* One-time registration of IOC shutdown hook + list init (reentrant-safe). */
     motorShutdownEnsureInit();
     
     /* Register this task's wake event so IOC shutdown can wake the wait(). */
-    if (motorShutdownLock && tabptr && tabptr->semptr)
-    {
-        motorWakeNode *wn = (motorWakeNode*)calloc(1, sizeof(*wn));
-        if (wn)
-        {
-            wn->ev = tabptr->semptr;
-            epicsMutexLock(motorShutdownLock);
-            ellAdd(&motorShutdownWakeList, &wn->node);
-            epicsMutexUnlock(motorShutdownLock);
-        }
-    }
+    motorShutdownAddWake(tabptr->semptr);
     
     if (args->update_delay == 0.0)
         stale_data_max_delay = 0.0;
@@ -213,28 +400,27 @@ epicsShareFunc int motor_task(struct thread_args *args)
 
     half_quantum = quantum / 2;
 
+    if (cardThreads && tabptr->card_threads)
+        start_card_workers(tabptr, stale_data_max_delay);
+
     for(;;)
     {
-        if (*tabptr->any_inmotion_ptr == 0)
+        if (pvt->num_active == 0)
             wait_time = 1000;   /* Wait forever = 1,000 seconds. */
-        else if (stale_data_delay != 0)
-        {
-            wait_time = stale_data_delay;
-            stale_data_delay = 0;
-        }
         else
         {
             current_time = epicsTime::getCurrent();
-            time_lapse = current_time - previous_time;
-            if (time_lapse < scan_sec)
+            wait_time = 1000;
+            for (itera = 0; itera < pvt->num_active; itera++)
             {
-                wait_time = scan_sec - time_lapse;
-                if (wait_time < half_quantum)
-                    wait_time = 0.0;
+                double due = pvt->cards[pvt->active_cards[itera]].next_poll - current_time;
+                if (due < wait_time)
+                    wait_time = due;
             }
-            else
+            if (wait_time < half_quantum)
                 wait_time = 0.0;
         }
+        wait_time = parked_wait(pvt->parked, epicsTime::getCurrent(), wait_time);
 
         Debug(5, "motor_task: wait_time = %f\n", wait_time);
 
@@ -248,26 +434,164 @@ epicsShareFunc int motor_task(struct thread_args *args)
             break;
         }
         
-        if (*tabptr->any_inmotion_ptr)
+        /* Go backwards, query_axis() may move the last active card to this index. */
+        bool started = false;
+        for (itera = pvt->num_active - 1; itera >= 0; itera--)
         {
-            if (tabptr->strtstat != NULL)
-                (*tabptr->strtstat) (ALL_CARDS);        /* Start data area update on motor cards */
+            int card = pvt->active_cards[itera];
+            struct card_poll *cardptr = &pvt->cards[card];
+            struct controller *brdptr = (*tabptr->card_array)[card];
 
-            for (itera = 0; itera < *tabptr->cardcnt_ptr; itera++)
+            if (cardptr->next_poll - previous_time >= half_quantum)
+                continue;
+            if (brdptr == NULL || brdptr->motor_in_motion == 0)
             {
-                struct controller *brdptr = (*tabptr->card_array)[itera];
-                if (brdptr != NULL && brdptr->motor_in_motion)
-                    stale_data_delay = query_axis(itera, tabptr, previous_time, stale_data_max_delay);
+                clear_card_in_motion(pvt, card);
+                continue;
             }
+            if (started == false && tabptr->strtstat != NULL)
+                timed_strtstat(tabptr, ALL_CARDS);      /* Start data area update on motor cards */
+            started = true;
+
+            stale_data_delay = query_axis(card, tabptr, previous_time, stale_data_max_delay, NULL);
+            if (cardptr->active_index >= 0)
+                cardptr->next_poll = previous_time +
+                    (stale_data_delay != 0.0 ? stale_data_delay : cardptr->period);
         }
         process_messages(tabptr, previous_time, stale_data_max_delay);
+        process_parked(tabptr, &pvt->parked, previous_time, stale_data_max_delay, NULL);
     }
     return(0);
 }
 
 
+/*
+ * Worker thread of one card.  It runs the motor_task() loop for the card: it
+ * polls the card while it has motors in motion and processes the messages
+ * that motor_task() has queued for it.
+ */
+static void card_worker_task(void *arg)
+{
+    struct card_worker *worker = (struct card_worker *) arg;
+    struct driver_table *tabptr = worker->tabptr;
+    const double half_quantum = epicsThreadSleepQuantum() / 2;
+    struct mess_node *node;
+    epicsTime tick;
+    double wait_time, delay;
+
+    for(;;)
+    {
+        if (worker->moving == false)
+            wait_time = 1000;   /* Wait forever = 1,000 seconds. */
+        else
+        {
+            wait_time = worker->next_poll - epicsTime::getCurrent();
+            if (wait_time < half_quantum)
+                wait_time = 0.0;
+        }
+        wait_time = parked_wait(worker->parked, epicsTime::getCurrent(), wait_time);
+        if (wait_time != 0.0)
+            worker->event->wait(wait_time);
+        tick = epicsTime::getCurrent();
+
+        if (epicsAtomicGetIntT(&motorShutdown))
+            break;
+
+        if (worker->moving == true && worker->next_poll - tick < half_quantum)
+        {
+            if (tabptr->strtstat != NULL)
+                timed_strtstat(tabptr, worker->card);
+            delay = query_axis(worker->card, tabptr, tick, worker->max_delay, worker);
+            if (worker->moving == true)
+                worker->next_poll = tick + (delay != 0.0 ? delay : worker->period);
+        }
+
+        for(;;)
+        {
+            epicsMutexMustLock(worker->lock);
+            node = worker->head;
+            if (node)
+            {
+                worker->head = node->next;
+                if (!worker->head)
+                    worker->tail = (struct mess_node *) NULL;
+            }
+            epicsMutexUnlock(worker->lock);
+            if (!node)
+                break;
+            process_message(tabptr, node, tick, worker->max_delay, worker);
+        }
+        flush_commands(tabptr, &worker->batch);
+        process_parked(tabptr, &worker->parked, tick, worker->max_delay, worker);
+    }
+}
+
+/* Starts a worker thread for each card of the driver table.  Called by motor_task(). */
+static void start_card_workers(struct driver_table *tabptr, double max_delay)
+{
+    struct motordrvComPvt *pvt = tabptr->comPvt;
+    char name[32];
+    int itera;
+
+    if (*tabptr->cardcnt_ptr <= 0)
+        return;
+
+    pvt->workers = new struct card_worker[*tabptr->cardcnt_ptr];
+    for (itera = 0; itera < *tabptr->cardcnt_ptr; itera++)
+    {
+        struct card_worker *worker = &pvt->workers[itera];
+
+        worker->tabptr = tabptr;
+        worker->card = itera;
+        worker->event = new epicsEvent(epicsEventEmpty);
+        worker->lock = epicsMutexMustCreate();
+        worker->head = worker->tail = (struct mess_node *) NULL;
+        worker->moving = false;
+        worker->period = pvt->scan_sec;
+        worker->max_delay = max_delay;
+        worker->parked = (struct mess_node *) NULL;
+        worker->batch.count = 0;
+        worker->batch.line = NULL;
+        motorShutdownAddWake(worker->event);
+
+        epicsSnprintf(name, sizeof(name), "%.24s_%d", epicsThreadGetNameSelf(), itera);
+        epicsThreadMustCreate(name, epicsThreadGetPrioritySelf(),
+                              epicsThreadGetStackSize(epicsThreadStackMedium),
+                              (EPICSTHREADFUNC) card_worker_task, (void *) worker);
+    }
+    pvt->num_workers = *tabptr->cardcnt_ptr;
+}
+
+/* Returns the poll period of a card that starts moving. */
+static double card_period(struct motordrvComPvt *pvt, int card)
+{
+    double period = pvt->scan_sec;
+
+    epicsMutexMustLock(pvt->lock);
+    if (card < pvt->num_scan_secs && pvt->card_scan_sec[card] != 0.0)
+        period = pvt->card_scan_sec[card];
+    epicsMutexUnlock(pvt->lock);
+    return (period);
+}
+
+/* Marks a card as having motors in motion, in its worker or in motor_task(). */
+static void mark_in_motion(struct driver_table *tabptr, struct card_worker *worker, int card,
+                           epicsTime tick)
+{
+    if (worker == NULL)
+        set_card_in_motion(tabptr->comPvt, card, tick);
+    else if (worker->moving == false)
+    {
+        worker->moving = true;
+        count_moving(tabptr->comPvt, 1);
+        worker->period = card_period(tabptr->comPvt, card);
+        worker->next_poll = tick + worker->period;
+    }
+}
+
+
 static double query_axis(int card, struct driver_table *tabptr, epicsTime tick,
-                         double max_delay)
+                         double max_delay, struct card_worker *worker)
 {
     struct controller *brdptr;
     double rtndelay = 0.0;
@@ -298,7 +622,7 @@ static double query_axis(int card, struct driver_table *tabptr, epicsTime tick,
                 if (delay > rtndelay)
                     rtndelay = delay;
             }
-            else if ((*tabptr->setstat) (card, index))
+            else if (timed_setstat(tabptr, card, index))
             {
                 struct mess_node *mess_ret;
                 bool ls_active;
@@ -308,7 +632,7 @@ static double query_axis(int card, struct driver_table *tabptr, epicsTime tick,
                 motor_motion->velocity = motor_info->velocity;
                 motor_motion->status = motor_info->status;
 
-                mess_ret = (struct mess_node *) motor_malloc(tabptr->freeptr, tabptr->freelockptr);
+                mess_ret = (struct mess_node *) motor_malloc(tabptr);
                 mess_ret->callback = motor_motion->callback;
                 mess_ret->mrecord = motor_motion->mrecord;
                 mess_ret->position = motor_motion->position;
@@ -344,11 +668,17 @@ static double query_axis(int card, struct driver_table *tabptr, epicsTime tick,
                     mess_ret->status.Bits.RA_DONE = 1;
                 }
 
-                callbackRequest(&mess_ret->callback);
+                post_status(tabptr, card, index, mess_ret);
 
                 if (brdptr->motor_in_motion == 0)
                 {
-                    SET_MM_OFF(*tabptr->any_inmotion_ptr, card);
+                    if (worker == NULL)
+                        clear_card_in_motion(tabptr->comPvt, card);
+                    else
+                    {
+                        worker->moving = false;
+                        count_moving(tabptr->comPvt, -1);
+                    }
                 }
             }
         }
@@ -361,100 +691,462 @@ static double query_axis(int card, struct driver_table *tabptr, epicsTime tick,
 static void process_messages(struct driver_table *tabptr, epicsTime tick,
                              double max_delay)
 {
-    struct mess_node *node, *motor_motion;
-    double delay;
+    struct motordrvComPvt *pvt = tabptr->comPvt;
+    struct mess_node *node;
 
     Debug(5, "process_messages: entry\n");
 
     while ((node = get_head_node(tabptr)))
     {
-        int card, axis;
+        if (node->send_time != 0)
+        {
+            epicsUInt64 wait = monotonic_ns() - node->send_time;
 
-        card = node->card;
-        axis = node->signal;
+            epicsMutexMustLock(pvt->lock);
+            add_call_time(&pvt->queue_wait, wait);
+            epicsMutexUnlock(pvt->lock);
+        }
 
-        if ((card >= 0 && card < *tabptr->cardcnt_ptr) &&
-            (*tabptr->card_array)[card] &&
-            (axis >= 0 && axis < (*tabptr->card_array)[card]->total_axis))
+        if (node->card >= 0 && node->card < pvt->num_workers)
         {
-            struct mess_info *motor_info;
-            struct controller *brdptr;
-            char inbuf[MAX_MSG_SIZE];
-            const char *axis_name;
+            /* Hand the message to the card's worker thread. */
+            struct card_worker *worker = &pvt->workers[node->card];
 
-            if (tabptr->axis_names == NULL)
-                axis_name = (char *) NULL;
+            node->next = (struct mess_node *) NULL;
+            epicsMutexMustLock(worker->lock);
+            if (worker->tail)
+                worker->tail->next = node;
             else
-                axis_name = tabptr->axis_names[axis];
+                worker->head = node;
+            worker->tail = node;
+            epicsMutexUnlock(worker->lock);
+            worker->event->signal();
+        }
+        else
+            process_message(tabptr, node, tick, max_delay, NULL);
+    }
+    flush_commands(tabptr, &pvt->batch);
+    Debug(5, "process_messages: exit\n");
+}
 
-            motor_info = &((*tabptr->card_array)[card]->motor_info[axis]);
-            motor_motion = motor_info->motor_motion;
-            brdptr = (*tabptr->card_array)[card];
 
-            switch (node->type)
-            {
-            case VELOCITY:
-                (*tabptr->sendmsg) (card, node->message, axis_name);
-                if (brdptr->cmnd_response == true)
-                    (*tabptr->getmsg) (card, inbuf, 1);
-
-                /*
-                 * this is tricky - another motion is here there is a very
-                 * large assumption being made here: that the person who sent
-                 * the previous motion is the same one that is sending this
-                 * one, if he weren't, the guy that sent the original would
-                 * never get notified of finish motion.  This makes sense in
-                 * record processing since only one record can be assigned to
-                 * an axis and sent commands to it. An improvement would be
-                 * to check and see if the record pointers were the same, if
-                 * they were not, then send a finish message to the previous
-                 * registered motion guy.
-                 */
-
-                if (!motor_motion)      /* if NULL */
-                    (*tabptr->card_array)[card]->motor_in_motion++;
-                else
-                    motor_free(motor_motion, tabptr);
+/*
+ * Sends a command to a card.  If the driver provides coalesce() the command
+ * is added to "batch" instead, and the batch is sent by flush_commands() when
+ * a command for another card or one that does not fit in the line comes, at
+ * the end of the queued messages, or before an INFO request.
+ */
+static void send_command(struct driver_table *tabptr, struct cmnd_batch *batch, int card,
+                         const char *message, const char *axis_name)
+{
+    if (tabptr->coalesce == NULL || tabptr->coalesce_len <= 0)
+    {
+        char inbuf[MAX_MSG_SIZE];
 
-                SET_MM_ON(*tabptr->any_inmotion_ptr, card);
-                motor_info->motor_motion = node;
-                motor_info->status_delay = tick;
-                break;
+        timed_sendmsg(tabptr, card, message, axis_name);
+        if ((*tabptr->card_array)[card]->cmnd_response == true)
+            timed_getmsg(tabptr, card, inbuf, 1);
+        return;
+    }
 
-            case MOTION:
-                (*tabptr->sendmsg) (card, node->message, axis_name);
-                if (brdptr->cmnd_response == true)
-                    (*tabptr->getmsg) (card, inbuf, 1);
+    if (batch->count > 0 && batch->card != card)
+        flush_commands(tabptr, batch);
 
-                /* this is tricky - see velocity comment */
-                if (!motor_motion)      /* if NULL */
-                    (*tabptr->card_array)[card]->motor_in_motion++;
-                else
-                    motor_free(motor_motion, tabptr);
+    if (batch->count == 1)
+    {
+        /* Start the line with the first command. */
+        if (batch->line == NULL)
+            batch->line = (char *) callocMustSucceed(1, tabptr->coalesce_len + 1, "motordrvCom batch");
+        batch->line[0] = '\0';
+        if ((*tabptr->coalesce) (card, batch->line, tabptr->coalesce_len + 1,
+                                 batch->first, batch->first_axis) != 0)
+            flush_commands(tabptr, batch);
+    }
+    if (batch->count > 0 &&
+        (*tabptr->coalesce) (card, batch->line, tabptr->coalesce_len + 1, message, axis_name) != 0)
+        flush_commands(tabptr, batch);
 
-                SET_MM_ON(*tabptr->any_inmotion_ptr, card);
-                motor_info->no_motion_count = 0;
-                motor_info->motor_motion = node;
-                motor_info->status_delay = tick;
-                break;
+    if (batch->count == 0)
+    {
+        batch->card = card;
+        strcpy(batch->first, message);
+        batch->first_axis = axis_name;
+    }
+    batch->count++;
+}
 
-            case INFO:
-                /* Status update delay - needed for OMS. */
-                delay = tick - motor_info->status_delay;
-                /* Limit delay to; 0 < delay <= max_delay. */
-                if (delay < 0.0)        /* Protect against negative delay. */
-                    delay = 0.0;
-                if (delay < max_delay)
-                    epicsThreadSleep(max_delay - delay);
+/* Sends the commands in "batch", as one line if there are several. */
+static void flush_commands(struct driver_table *tabptr, struct cmnd_batch *batch)
+{
+    char inbuf[MAX_MSG_SIZE];
+    int card = batch->card;
+    int itera;
+
+    if (batch->count == 0)
+        return;
+
+    if (batch->count == 1)
+        timed_sendmsg(tabptr, card, batch->first, batch->first_axis);
+    else
+    {
+        struct motordrvComPvt *pvt = tabptr->comPvt;
+
+        timed_sendmsg(tabptr, card, batch->line, NULL);
+        epicsMutexMustLock(pvt->lock);
+        pvt->coalesced_lines++;
+        pvt->coalesced_cmnds += batch->count;
+        epicsMutexUnlock(pvt->lock);
+    }
+    /* Read the response to each command of the line, as when they are sent on their own. */
+    if ((*tabptr->card_array)[card]->cmnd_response == true)
+        for (itera = 0; itera < batch->count; itera++)
+            timed_getmsg(tabptr, card, inbuf, 1);
+    batch->count = 0;
+}
+
+
+/*
+ * Callback function of the status nodes queued by post_status().  It
+ * releases the axis' slot, so that the next status update queues a new
+ * callback, and calls the node's own callback function.
+ */
+static void status_callback(CALLBACK *pcallback)
+{
+    struct status_slot *slot = (struct status_slot *) pcallback->user;
+    struct motordrvComPvt *pvt = slot->pvt;
+
+    epicsMutexMustLock(pvt->lock);
+    pcallback->callback = slot->callback;
+    pcallback->user = slot->user;
+    if (slot->node == (struct mess_node *) pcallback)
+        slot->node = (struct mess_node *) NULL;
+    epicsMutexUnlock(pvt->lock);
+
+    (*pcallback->callback) (pcallback);
+}
+
+/*
+ * Queues the status callback of an axis polled by query_axis().  If a status
+ * callback of the axis is still queued, the new status is copied into it
+ * instead, so a slow callback thread gets at most one status node per axis.
+ * The update is not merged when it changes the done, limit or problem bits
+ * from those in the queued node, so those transitions are always seen.
+ */
+static void post_status(struct driver_table *tabptr, int card, int axis, struct mess_node *node)
+{
+    struct motordrvComPvt *pvt = tabptr->comPvt;
+    struct status_slot *slot;
+    msta_field transitions;
+    bool merged = false;
+
+    transitions.All = 0;
+    transitions.Bits.RA_DONE = 1;
+    transitions.Bits.RA_PLUS_LS = 1;
+    transitions.Bits.RA_MINUS_LS = 1;
+    transitions.Bits.RA_PROBLEM = 1;
+
+    epicsMutexMustLock(pvt->lock);
+    if (card >= pvt->num_status_slots)
+    {
+        pvt->status_slots = (struct status_slot **)
+            realloc(pvt->status_slots, (card + 1) * sizeof(struct status_slot *));
+        while (pvt->num_status_slots <= card)
+            pvt->status_slots[pvt->num_status_slots++] = NULL;
+    }
+    if (pvt->status_slots[card] == NULL)
+    {
+        int itera;
+
+        pvt->status_slots[card] = (struct status_slot *)
+            callocMustSucceed(MAX_AXIS, sizeof(struct status_slot), "motordrvCom status");
+        for (itera = 0; itera < MAX_AXIS; itera++)
+            pvt->status_slots[card][itera].pvt = pvt;
+    }
+    slot = &pvt->status_slots[card][axis];
+
+    if (slot->node != NULL &&
+        ((slot->node->status.All ^ node->status.All) & transitions.All) == 0)
+    {
+        slot->node->mrecord = node->mrecord;
+        slot->node->position = node->position;
+        slot->node->encoder_position = node->encoder_position;
+        slot->node->velocity = node->velocity;
+        slot->node->status = node->status;
+        pvt->status_coalesced++;
+        merged = true;
+    }
+    else
+    {
+        /* An older node that is still queued keeps its slot pointer, but only
+         * the newest node is merged into from now on. */
+        slot->node = node;
+        slot->callback = node->callback.callback;
+        slot->user = node->callback.user;
+        node->callback.callback = status_callback;
+        node->callback.user = slot;
+        pvt->status_callbacks++;
+    }
+    epicsMutexUnlock(pvt->lock);
+
+    if (merged == true)
+        motor_free(node, tabptr);
+    else
+        callbackRequest(&node->callback);
+}
+
+/* Adds one time, in ns, to a call_stats.  Must be called with pvt->lock held. */
+/*
+ * Returns a monotonic time in ns for the timing statistics.  Base before
+ * 3.16.1 has no epicsMonotonicGet(), so the time of day is used there.
+ */
+static epicsUInt64 monotonic_ns(void)
+{
+#if LT_EPICSBASE(3,16,1,0)
+    epicsTimeStamp now;
+
+    epicsTimeGetCurrent(&now);
+    return ((epicsUInt64) now.secPastEpoch * 1000000000u + now.nsec);
+#else
+    return (epicsMonotonicGet());
+#endif
+}
+
+static void add_call_time(struct call_stats *stats, epicsUInt64 time)
+{
+    if (stats->count == 0 || time < stats->min)
+        stats->min = time;
+    if (time > stats->max)
+        stats->max = time;
+    stats->sum += time;
+    stats->count++;
+}
+
+/* Records the time of a driver hook call that started at "start", unless "start" is 0. */
+static void hook_done(struct driver_table *tabptr, int card, int hook, epicsUInt64 start)
+{
+    struct motordrvComPvt *pvt = tabptr->comPvt;
+    epicsUInt64 time;
+    int index = card + 1;
+
+    if (start == 0)
+        return;
+    time = monotonic_ns() - start;
+
+    epicsMutexMustLock(pvt->lock);
+    if (index >= pvt->num_hook_stats)
+    {
+        pvt->hook_stats = (struct call_stats (*)[NUM_HOOKS])
+            realloc(pvt->hook_stats, (index + 1) * sizeof(*pvt->hook_stats));
+        memset(pvt->hook_stats + pvt->num_hook_stats, 0,
+               (index + 1 - pvt->num_hook_stats) * sizeof(*pvt->hook_stats));
+        pvt->num_hook_stats = index + 1;
+    }
+    add_call_time(&pvt->hook_stats[index][hook], time);
+    epicsMutexUnlock(pvt->lock);
+}
+
+/*
+ * The driver hooks, timed when motorDrvComTiming is enabled.  When it is not
+ * the only overhead is the test of timingEnabled.
+ */
+static RTN_STATUS timed_sendmsg(struct driver_table *tabptr, int card, const char *message,
+                                const char *axis_name)
+{
+    epicsUInt64 start = timingEnabled ? monotonic_ns() : 0;
+    RTN_STATUS rtnval = (*tabptr->sendmsg) (card, message, axis_name);
+
+    hook_done(tabptr, card, HOOK_SENDMSG, start);
+    return (rtnval);
+}
+
+static int timed_getmsg(struct driver_table *tabptr, int card, char *buffer, int count)
+{
+    epicsUInt64 start = timingEnabled ? monotonic_ns() : 0;
+    int rtnval = (*tabptr->getmsg) (card, buffer, count);
+
+    hook_done(tabptr, card, HOOK_GETMSG, start);
+    return (rtnval);
+}
+
+static int timed_setstat(struct driver_table *tabptr, int card, int axis)
+{
+    epicsUInt64 start = timingEnabled ? monotonic_ns() : 0;
+    int rtnval = (*tabptr->setstat) (card, axis);
+
+    hook_done(tabptr, card, HOOK_SETSTAT, start);
+    return (rtnval);
+}
+
+static void timed_strtstat(struct driver_table *tabptr, int card)
+{
+    epicsUInt64 start = timingEnabled ? monotonic_ns() : 0;
+
+    (*tabptr->strtstat) (card);
+    hook_done(tabptr, card, HOOK_STRTSTAT, start);
+}
+
+
+/*
+ * Returns "wait_time" limited to the time until the first of the parked INFO
+ * requests is due, or zero if that is less than half a quantum.
+ */
+static double parked_wait(struct mess_node *parked, epicsTime now, double wait_time)
+{
+    double due;
+
+    if (parked == NULL)
+        return (wait_time);
+    due = epicsTime(parked->info_due) - now;
+    if (due < epicsThreadSleepQuantum() / 2)
+        return (0.0);
+    return (due < wait_time) ? due : wait_time;
+}
+
+/* Adds an INFO request to a parked list, after the requests due at the same time or earlier. */
+static void park_info(struct mess_node **listp, struct mess_node *node, epicsTime due)
+{
+    node->info_due = due;
+    while (*listp && !(due < epicsTime((*listp)->info_due)))
+        listp = &(*listp)->next;
+    node->next = *listp;
+    *listp = node;
+}
+
+/*
+ * Processes the parked INFO requests that are due.  They are taken off the
+ * list first, so a request that process_message() parks again is not
+ * processed twice.
+ */
+static void process_parked(struct driver_table *tabptr, struct mess_node **listp, epicsTime tick,
+                           double max_delay, struct card_worker *worker)
+{
+    const double half_quantum = epicsThreadSleepQuantum() / 2;
+    struct mess_node *due = NULL, **duetail = &due;
+    struct mess_node *node;
+
+    while (*listp && epicsTime((*listp)->info_due) - tick < half_quantum)
+    {
+        *duetail = *listp;
+        duetail = &(*listp)->next;
+        *listp = (*listp)->next;
+    }
+    *duetail = NULL;
+
+    while ((node = due))
+    {
+        due = node->next;
+        process_message(tabptr, node, tick, max_delay, worker);
+    }
+}
+
+/*
+ * Processes one message, in motor_task() or, with "worker" not NULL, in the
+ * worker thread of its card.
+ */
+static void process_message(struct driver_table *tabptr, struct mess_node *node, epicsTime tick,
+                            double max_delay, struct card_worker *worker)
+{
+    struct cmnd_batch *batch = worker ? &worker->batch : &tabptr->comPvt->batch;
+    struct mess_node *motor_motion;
+    double delay;
+    int card, axis;
+
+    card = node->card;
+    axis = node->signal;
+
+    if ((card >= 0 && card < *tabptr->cardcnt_ptr) &&
+        (*tabptr->card_array)[card] &&
+        (axis >= 0 && axis < (*tabptr->card_array)[card]->total_axis))
+    {
+        struct mess_info *motor_info;
+        const char *axis_name;
+
+        if (tabptr->axis_names == NULL)
+            axis_name = (char *) NULL;
+        else
+            axis_name = tabptr->axis_names[axis];
+
+        motor_info = &((*tabptr->card_array)[card]->motor_info[axis]);
+        motor_motion = motor_info->motor_motion;
+
+        switch (node->type)
+        {
+        case VELOCITY:
+            send_command(tabptr, batch, card, node->message, axis_name);
+
+            /*
+             * this is tricky - another motion is here there is a very
+             * large assumption being made here: that the person who sent
+             * the previous motion is the same one that is sending this
+             * one, if he weren't, the guy that sent the original would
+             * never get notified of finish motion.  This makes sense in
+             * record processing since only one record can be assigned to
+             * an axis and sent commands to it. An improvement would be
+             * to check and see if the record pointers were the same, if
+             * they were not, then send a finish message to the previous
+             * registered motion guy.
+             */
+
+            if (!motor_motion)      /* if NULL */
+                (*tabptr->card_array)[card]->motor_in_motion++;
+            else
+                motor_free(motor_motion, tabptr);
+
+            mark_in_motion(tabptr, worker, card, tick);
+            motor_info->motor_motion = node;
+            motor_info->status_delay = tick;
+            break;
+
+        case MOTION:
+            send_command(tabptr, batch, card, node->message, axis_name);
+
+            /* this is tricky - see velocity comment */
+            if (!motor_motion)      /* if NULL */
+                (*tabptr->card_array)[card]->motor_in_motion++;
+            else
+                motor_free(motor_motion, tabptr);
+
+            mark_in_motion(tabptr, worker, card, tick);
+            motor_info->no_motion_count = 0;
+            motor_info->motor_motion = node;
+            motor_info->status_delay = tick;
+            break;
+
+        case INFO:
+            /* Status update delay - needed for OMS. */
+            delay = tick - motor_info->status_delay;
+            /* Limit delay to; 0 < delay <= max_delay. */
+            if (delay < 0.0)        /* Protect against negative delay. */
+                delay = 0.0;
+            if (max_delay - delay >= epicsThreadSleepQuantum() / 2)
+            {
+                /* Not due yet; park it so other messages are not held up. */
+                struct motordrvComPvt *pvt = tabptr->comPvt;
+
+                /* Count each request once; a parked request is parked again
+                 * if a move restarted the stale data delay meanwhile. */
+                if (node->info_due.secPastEpoch == 0 && node->info_due.nsec == 0)
+                {
+                    epicsMutexMustLock(pvt->lock);
+                    pvt->info_parked++;
+                    pvt->sleep_avoided += max_delay - delay;
+                    epicsMutexUnlock(pvt->lock);
+                }
+                park_info(worker ? &worker->parked : &pvt->parked, node,
+                          motor_info->status_delay + max_delay);
+                break;
+            }
 
-                if (tabptr->strtstat != NULL)
-                    (*tabptr->strtstat) (card);
-                (*tabptr->setstat) (card, axis);
+            /* The status must follow any commands sent before. */
+            flush_commands(tabptr, batch);
+            if (tabptr->strtstat != NULL)
+                timed_strtstat(tabptr, card);
+            timed_setstat(tabptr, card, axis);
 
-                node->position = motor_info->position;
-                node->encoder_position = motor_info->encoder_position;
-                node->status = motor_info->status;
-                node->velocity = motor_info->velocity;
+            node->position = motor_info->position;
+            node->encoder_position = motor_info->encoder_position;
+            node->status = motor_info->status;
+            node->velocity = motor_info->velocity;
 
 /*=============================================================================
 * node->status & RA_DONE is not a reliable indicator of anything, in this case,
@@ -463,70 +1155,81 @@ static void process_messages(struct driver_table *tabptr, epicsTime tick,
 * Nevertheless, recMotor:process() needs to know whether the motor has stopped,
 * and this we can tell by looking for a struct motor_motion.
 ==============================================================================*/
-                if (motor_motion)
-                    node->status.Bits.RA_DONE = 0;
-                else
-                    node->status.Bits.RA_DONE = 1;
+            if (motor_motion)
+                node->status.Bits.RA_DONE = 0;
+            else
+                node->status.Bits.RA_DONE = 1;
 
-                callbackRequest((CALLBACK *) node);
-                break;
+            callbackRequest((CALLBACK *) node);
+            break;
 
-            case MOVE_TERM:
-                if (motor_motion != NULL)
-                    motor_motion->message[0] = '0';     /* Clear 2nd command from buffer. */
-                (*tabptr->sendmsg) (card, node->message, axis_name);
-                if (brdptr->cmnd_response == true)
-                    (*tabptr->getmsg) (card, inbuf, 1);
-                motor_free(node, tabptr);       /* free message buffer */
-                break;
+        case MOVE_TERM:
+            if (motor_motion != NULL)
+                motor_motion->message[0] = '0';     /* Clear 2nd command from buffer. */
+            send_command(tabptr, batch, card, node->message, axis_name);
+            motor_free(node, tabptr);       /* free message buffer */
+            break;
 
-            default:
-                (*tabptr->sendmsg) (card, node->message, axis_name);
-                if (brdptr->cmnd_response == true)
-                    (*tabptr->getmsg) (card, inbuf, 1);
-                motor_free(node, tabptr);       /* free message buffer */
-                motor_info->status_delay = tick;
-                break;
-            }
-        }
-        else
-        {
-            node->position = 0;
-            node->encoder_position = 0;
-            node->velocity = 0;
-            node->status.All = 0;
-            node->status.Bits.RA_PROBLEM = 1;
-            callbackRequest((CALLBACK *) node);
+        default:
+            send_command(tabptr, batch, card, node->message, axis_name);
+            motor_free(node, tabptr);       /* free message buffer */
+            motor_info->status_delay = tick;
+            break;
         }
     }
-    Debug(5, "process_messages: exit\n");
+    else
+    {
+        node->position = 0;
+        node->encoder_position = 0;
+        node->velocity = 0;
+        node->status.All = 0;
+        node->status.Bits.RA_PROBLEM = 1;
+        callbackRequest((CALLBACK *) node);
+    }
 }
 
 
 /*****************************************************/
 /* Get a message off the queue */
 /* get_head_node()                           */
+/*
+ * The message queue is lock-free.  motor_send() pushes new nodes onto
+ * queptr->tail, which is a LIFO list.  This function is only called by
+ * motor_task(), the single consumer.  When queptr->head is empty it takes the
+ * whole tail list with one atomic swap and reverses it onto queptr->head,
+ * which only it uses, so the nodes are returned in the order they were sent.
+ */
 /*****************************************************/
 static struct mess_node *get_head_node(struct driver_table *tabptr)
 {
     struct circ_queue *qptr;
-    struct mess_node *node;
+    struct mess_node *node, *list, *next;
 
-    tabptr->quelockptr->wait();
     qptr = tabptr->queptr;
-    node = qptr->head;
+    if (!qptr->head)
+    {
+        do
+        {
+            list = (struct mess_node *) epicsAtomicGetPtrT((EpicsAtomicPtrT *) &qptr->tail);
+        } while (list && epicsAtomicCmpAndSwapPtrT((EpicsAtomicPtrT *) &qptr->tail, list, NULL) != list);
+
+        while (list)
+        {
+            next = list->next;
+            list->next = qptr->head;
+            qptr->head = list;
+            list = next;
+        }
+    }
 
     /* delete node from list */
+    node = qptr->head;
     if (node)
     {
-        if (node == qptr->head)
-            qptr->head = node->next;
-        if (node == qptr->tail)
-            qptr->tail = NULL;
+        qptr->head = node->next;
+        epicsAtomicDecrIntT(&tabptr->comPvt->queue_depth);
     }
 
-    tabptr->quelockptr->signal();
-
     return (node);
 }
 
@@ -539,16 +1242,18 @@ static struct mess_node *get_head_node(struct driver_table *tabptr)
  *  Allocate message node - call motor_malloc().
  *  Copy info. from input node to new node.
  *  Process node based on "type".
- *  Lock motor task queue.
- *  Insert new node at tail of queue.
+ *  Push new node onto the tail list of the queue without locking
+ *  (see get_head_node()).
+ *  Signal motor task.
  */
 
 epicsShareFunc RTN_STATUS motor_send(struct mess_node *u_msg, struct driver_table *tabptr)
 {
-    struct mess_node *new_message;
+    struct mess_node *new_message, *old_tail;
     struct circ_queue *qptr;
+    int depth;
 
-    new_message = motor_malloc(tabptr->freeptr, tabptr->freelockptr);
+    new_message = motor_malloc(tabptr);
     new_message->callback = u_msg->callback;
     new_message->next = (struct mess_node *) NULL;
     new_message->type = u_msg->type;
@@ -559,6 +1264,9 @@ epicsShareFunc RTN_STATUS motor_send(struct mess_node *u_msg, struct driver_tabl
     strcpy(new_message->message, u_msg->message);
     new_message->postmsgptr = u_msg->postmsgptr;
     new_message->termstring = u_msg->termstring;
+    new_message->info_due.secPastEpoch = 0;     /* Not parked yet. */
+    new_message->info_due.nsec = 0;
+    new_message->send_time = timingEnabled ? monotonic_ns() : 0;
 
     switch (new_message->type)
     {
@@ -575,76 +1283,363 @@ epicsShareFunc RTN_STATUS motor_send(struct mess_node *u_msg, struct driver_tabl
             return (ERROR);
     }
 
-    /* Lock queue */
-    tabptr->quelockptr->wait();
-
     qptr = tabptr->queptr;
-    if (qptr->tail)
+    do
+    {
+        old_tail = (struct mess_node *) epicsAtomicGetPtrT((EpicsAtomicPtrT *) &qptr->tail);
+        new_message->next = old_tail;
+    } while (epicsAtomicCmpAndSwapPtrT((EpicsAtomicPtrT *) &qptr->tail, old_tail, new_message) != old_tail);
+
+    depth = epicsAtomicIncrIntT(&tabptr->comPvt->queue_depth);
+    if (timingEnabled)
     {
-        qptr->tail->next = new_message;
-        qptr->tail = new_message;
+        int *maxp = &tabptr->comPvt->max_queue_depth;
+        int max = epicsAtomicGetIntT(maxp);
+        int prev;
+
+        /* Other threads may be sending too; retry until depth is stored or is not the maximum. */
+        while (depth > max && (prev = epicsAtomicCmpAndSwapIntT(maxp, max, depth)) != max)
+            max = prev;
     }
-    else
+
+    tabptr->semptr->signal();
+    return (OK);
+}
+
+static void poolInitOnce(void *arg)
+{
+    ellInit(&poolList);
+    poolListLock = epicsMutexMustCreate();
+}
+
+/*
+ * Returns the node pool of a driver table, creating it on first use with
+ * poolSize nodes.
+ */
+static struct motordrvComPvt *get_com_pvt(struct driver_table *tabptr)
+{
+    struct motordrvComPvt *pvt;
+    char *aligned;
+    int itera;
+
+    pvt = (struct motordrvComPvt *) epicsAtomicGetPtrT((EpicsAtomicPtrT *) &tabptr->comPvt);
+    if (pvt)
+        return (pvt);
+
+    epicsThreadOnce(&poolOnce, poolInitOnce, NULL);
+    epicsMutexMustLock(poolListLock);
+    pvt = tabptr->comPvt;
+    if (!pvt)
     {
-        qptr->tail = new_message;
-        qptr->head = new_message;
+        pvt = (struct motordrvComPvt *) callocMustSucceed(1, sizeof(*pvt), "motordrvCom pool");
+        pvt->tabptr = tabptr;
+        pvt->lock = epicsMutexMustCreate();
+        pvt->report_time = epicsTime::getCurrent();
+        pvt->size = poolSize;
+        pvt->stride = (sizeof(struct mess_node) + NODE_ALIGN - 1) & ~(size_t) (NODE_ALIGN - 1);
+        aligned = (char *) callocMustSucceed(1, pvt->size * pvt->stride + NODE_ALIGN, "motordrvCom pool");
+        aligned += (NODE_ALIGN - ((size_t) aligned % NODE_ALIGN)) % NODE_ALIGN;
+        pvt->block = aligned;
+        for (itera = pvt->size - 1; itera >= 0; itera--)
+        {
+            struct mess_node *node = (struct mess_node *) (pvt->block + itera * pvt->stride);
+            node->next = pvt->free_list;
+            pvt->free_list = node;
+        }
+        ellAdd(&poolList, &pvt->node);
+        epicsAtomicSetPtrT((EpicsAtomicPtrT *) &tabptr->comPvt, pvt);
     }
+    epicsMutexUnlock(poolListLock);
+    return (pvt);
+}
 
+/* Grows the per card arrays of the cards in motion to hold "card". */
+static void grow_cards(struct motordrvComPvt *pvt, int card)
+{
+    struct card_poll *cards;
+    int num_cards, itera;
 
-    /* Unlock message queue */
-    tabptr->quelockptr->signal();
+    if (card < pvt->num_cards)
+        return;
 
-    tabptr->semptr->signal();
-    return (OK);
+    num_cards = *pvt->tabptr->cardcnt_ptr;
+    if (num_cards <= card)
+        num_cards = card + 1;
+    num_cards = (num_cards + 31) & ~31;         /* Whole words of the bitmap. */
+
+    cards = new struct card_poll[num_cards];
+    for (itera = 0; itera < num_cards; itera++)
+    {
+        if (itera < pvt->num_cards)
+            cards[itera] = pvt->cards[itera];
+        else
+        {
+            cards[itera].period = 0.0;
+            cards[itera].active_index = -1;
+        }
+    }
+    delete [] pvt->cards;
+    pvt->cards = cards;
+
+    pvt->inmotion_map = (epicsUInt32 *) realloc(pvt->inmotion_map, MAP_WORD(num_cards) * sizeof(epicsUInt32));
+    for (itera = MAP_WORD(pvt->num_cards); itera < MAP_WORD(num_cards); itera++)
+        pvt->inmotion_map[itera] = 0;
+    pvt->active_cards = (int *) realloc(pvt->active_cards, num_cards * sizeof(int));
+    pvt->num_cards = num_cards;
 }
 
-static struct mess_node *motor_malloc(struct circ_queue *freelistptr, epicsEvent *lockptr)
+/*
+ * Adds a card to the cards in motion; its first poll is one poll period
+ * after "tick".  Only called by motor_task().
+ */
+static void set_card_in_motion(struct motordrvComPvt *pvt, int card, epicsTime tick)
 {
-    struct mess_node *node;
+    struct card_poll *cardptr;
 
-    lockptr->wait();
+    if (card < pvt->num_cards && (pvt->inmotion_map[MAP_WORD(card)] & MAP_BIT(card)))
+        return;
 
-    if (!freelistptr->head)
-        node = (struct mess_node *) malloc(sizeof(struct mess_node));
-    else
+    grow_cards(pvt, card);
+    cardptr = &pvt->cards[card];
+    cardptr->period = card_period(pvt, card);
+
+    pvt->inmotion_map[MAP_WORD(card)] |= MAP_BIT(card);
+    cardptr->active_index = pvt->num_active;
+    cardptr->next_poll = tick + cardptr->period;
+    pvt->active_cards[pvt->num_active++] = card;
+    count_moving(pvt, 1);
+}
+
+/* Removes a card from the cards in motion.  Only called by motor_task(). */
+static void clear_card_in_motion(struct motordrvComPvt *pvt, int card)
+{
+    int index, last;
+
+    if (card >= pvt->num_cards || !(pvt->inmotion_map[MAP_WORD(card)] & MAP_BIT(card)))
+        return;
+
+    pvt->inmotion_map[MAP_WORD(card)] &= ~MAP_BIT(card);
+    index = pvt->cards[card].active_index;
+    last = pvt->active_cards[--pvt->num_active];
+    pvt->active_cards[index] = last;
+    pvt->cards[last].active_index = index;
+    pvt->cards[card].active_index = -1;
+    count_moving(pvt, -1);
+}
+
+/*
+ * Adds "delta" to the number of cards in motion and stores it in
+ * *any_inmotion_ptr.  Called by motor_task() and by the card workers.
+ */
+static void count_moving(struct motordrvComPvt *pvt, int delta)
+{
+    epicsMutexMustLock(pvt->lock);
+    pvt->num_moving += delta;
+    *pvt->tabptr->any_inmotion_ptr = pvt->num_moving;
+    epicsMutexUnlock(pvt->lock);
+}
+
+/*
+ * Sets the poll rate, in HZ, of one card while it has motors in motion.  A
+ * rate of zero selects the rate given to motor_task().  The new rate is used
+ * from the next time the card starts moving.  There is no iocsh command for
+ * this, because the driver table is private to each driver; a driver calls it
+ * from its configuration function, or from an iocsh command of its own.
+ */
+epicsShareFunc int motor_card_scan_rate(int card, double rate, struct driver_table *tabptr)
+{
+    struct motordrvComPvt *pvt;
+
+    if (card < 0 || rate < 0.0)
+        return (-1);
+
+    pvt = get_com_pvt(tabptr);
+    epicsMutexMustLock(pvt->lock);
+    if (card >= pvt->num_scan_secs)
     {
-        node = freelistptr->head;
-        freelistptr->head = node->next;
-        if (!freelistptr->head)
-            freelistptr->tail = (struct mess_node *) NULL;
+        pvt->card_scan_sec = (double *) realloc(pvt->card_scan_sec, (card + 1) * sizeof(double));
+        while (pvt->num_scan_secs <= card)
+            pvt->card_scan_sec[pvt->num_scan_secs++] = 0.0;
     }
+    pvt->card_scan_sec[card] = (rate == 0.0) ? 0.0 : 1 / rate;
+    epicsMutexUnlock(pvt->lock);
+    return (0);
+}
 
-    lockptr->signal();
+/*
+ * Takes a node from the pool of the driver table.  If the pool is empty the
+ * node is allocated from the heap, and motor_free() returns it to the heap.
+ */
+static struct mess_node *motor_malloc(struct driver_table *tabptr)
+{
+    struct motordrvComPvt *pvt = get_com_pvt(tabptr);
+    struct mess_node *node;
+
+    epicsMutexMustLock(pvt->lock);
+    node = pvt->free_list;
+    if (node)
+        pvt->free_list = node->next;
+    else
+        pvt->exhausted++;
+    if (++pvt->in_use > pvt->high_water)
+        pvt->high_water = pvt->in_use;
+    epicsMutexUnlock(pvt->lock);
 
+    if (!node)
+        node = (struct mess_node *) malloc(sizeof(struct mess_node));
     return (node);
 }
 
 epicsShareFunc int motor_free(struct mess_node * node, struct driver_table *tabptr)
 {
-    struct circ_queue *freelistptr;
-    
-    freelistptr = tabptr->freeptr;
+    struct motordrvComPvt *pvt = get_com_pvt(tabptr);
+    bool in_pool;
 
-    tabptr->freelockptr->wait();
+    in_pool = ((char *) node >= pvt->block &&
+               (char *) node < pvt->block + pvt->size * pvt->stride);
 
-    node->next = (struct mess_node *) NULL;
-
-    if (freelistptr->tail)
+    epicsMutexMustLock(pvt->lock);
+    pvt->in_use--;
+    if (in_pool)
     {
-        freelistptr->tail->next = node;
-        freelistptr->tail = node;
+        node->next = pvt->free_list;
+        pvt->free_list = node;
     }
-    else
+    epicsMutexUnlock(pvt->lock);
+
+    if (!in_pool)
+        free(node);
+    return (0);
+}
+
+/*
+ * Enables a worker thread for each card in motor_task() instances started
+ * from now on, for the drivers that set driver_table card_threads; the others
+ * keep polling all their cards in motor_task().  Call before iocInit.
+ */
+epicsShareFunc int motorDrvComCardThreads(int enable)
+{
+    cardThreads = enable;
+    return (0);
+}
+
+/*
+ * Enables (non-zero) or disables timing of the driver hook calls of each card
+ * and of the message queue.  Enabling clears the statistics.  They are
+ * printed by motorDrvComReport.
+ */
+epicsShareFunc int motorDrvComTiming(int enable)
+{
+    struct motordrvComPvt *pvt;
+
+    epicsThreadOnce(&poolOnce, poolInitOnce, NULL);
+    if (enable)
     {
-        freelistptr->head = node;
-        freelistptr->tail = node;
+        epicsMutexMustLock(poolListLock);
+        for (pvt = (struct motordrvComPvt *) ellFirst(&poolList); pvt;
+             pvt = (struct motordrvComPvt *) ellNext(&pvt->node))
+        {
+            epicsMutexMustLock(pvt->lock);
+            if (pvt->hook_stats)
+                memset(pvt->hook_stats, 0, pvt->num_hook_stats * sizeof(*pvt->hook_stats));
+            memset(&pvt->queue_wait, 0, sizeof(pvt->queue_wait));
+            epicsAtomicSetIntT(&pvt->max_queue_depth, 0);
+            epicsMutexUnlock(pvt->lock);
+        }
+        epicsMutexUnlock(poolListLock);
     }
+    timingEnabled = enable;
+    return (0);
+}
 
-    tabptr->freelockptr->signal();
+/* Prints a call_stats line, with the times in ms. */
+static void print_call_stats(const char *name, struct call_stats *stats)
+{
+    if (stats->count == 0)
+        return;
+    printf("      %-10s count=%lu, min=%.3f, mean=%.3f, max=%.3f ms\n", name, stats->count,
+           stats->min / 1e6, (double) stats->sum / stats->count / 1e6, stats->max / 1e6);
+}
 
+/*
+ * Sets the number of nodes in the pools of driver tables that have not
+ * yet sent a message.  Call before iocInit.
+ */
+epicsShareFunc int motorDrvComPoolSize(int size)
+{
+    if (size < 1)
+    {
+        printf("motorDrvComPoolSize: size must be at least 1\n");
+        return (-1);
+    }
+    poolSize = size;
     return (0);
 }
 
+/* Prints the node pool statistics of each driver table. */
+epicsShareFunc void motorDrvComReport(int level)
+{
+    struct motordrvComPvt *pvt;
+
+    epicsThreadOnce(&poolOnce, poolInitOnce, NULL);
+    epicsMutexMustLock(poolListLock);
+    for (pvt = (struct motordrvComPvt *) ellFirst(&poolList); pvt;
+         pvt = (struct motordrvComPvt *) ellNext(&pvt->node))
+    {
+        epicsTime now = epicsTime::getCurrent();
+        double interval, avoided;
+        int itera;
+
+        epicsMutexMustLock(pvt->lock);
+        printf("Driver table %p: cards=%d, card threads=%d, in motion=%d, node pool size=%d, in use=%d, high water=%d, exhausted=%lu\n",
+               (void *) pvt->tabptr, *pvt->tabptr->cardcnt_ptr, pvt->num_workers, pvt->num_moving,
+               pvt->size, pvt->in_use, pvt->high_water, pvt->exhausted);
+        interval = now - pvt->report_time;
+        avoided = pvt->sleep_avoided - pvt->report_sleep_avoided;
+        printf("    INFO requests parked=%lu, sleep avoided=%.3f s, %.3f s/s since the last report\n",
+               pvt->info_parked, pvt->sleep_avoided, (interval > 0.0) ? avoided / interval : 0.0);
+        printf("    status callbacks=%lu, status updates coalesced=%lu\n",
+               pvt->status_callbacks, pvt->status_coalesced);
+        if (pvt->tabptr->coalesce != NULL)
+            printf("    coalesced lines=%lu, commands in them=%lu\n",
+                   pvt->coalesced_lines, pvt->coalesced_cmnds);
+        if (timingEnabled)
+        {
+            epicsMutexMustLock(pvt->lock);
+            printf("    queue depth=%d, max=%d\n",
+                   epicsAtomicGetIntT(&pvt->queue_depth),
+                   epicsAtomicGetIntT(&pvt->max_queue_depth));
+            print_call_stats("queue wait", &pvt->queue_wait);
+            for (itera = 0; itera < pvt->num_hook_stats; itera++)
+            {
+                int hook;
+
+                if (itera == 0)
+                    printf("    all cards:\n");
+                else
+                    printf("    card %d:\n", itera - 1);
+                for (hook = 0; hook < NUM_HOOKS; hook++)
+                    print_call_stats(hookNames[hook], &pvt->hook_stats[itera][hook]);
+            }
+            epicsMutexUnlock(pvt->lock);
+        }
+        pvt->report_time = now;
+        pvt->report_sleep_avoided = pvt->sleep_avoided;
+        epicsMutexUnlock(pvt->lock);
+        if (level > 0)
+        {
+            printf("    node size=%d bytes, pool memory=%d bytes\n",
+                   (int) pvt->stride, (int) (pvt->size * pvt->stride));
+            epicsMutexMustLock(pvt->lock);
+            for (itera = 0; itera < pvt->num_scan_secs; itera++)
+                if (pvt->card_scan_sec[itera] != 0.0)
+                    printf("    card %d: poll rate=%g HZ\n", itera, 1 / pvt->card_scan_sec[itera]);
+            epicsMutexUnlock(pvt->lock);
+        }
+    }
+    epicsMutexUnlock(poolListLock);
+}
+
 /*---------------------------------------------------------------------*/
 /*
  * both of these routines are only to be used at initialization time - before
@@ -699,3 +1694,54 @@ epicsShareFunc int motor_axis_info(int card, int signal, MOTOR_AXIS_QUERY * aq,
     return (0);
 }
 
+
+extern "C"
+{
+
+static const iocshArg poolSizeArg0 = {"Number of nodes", iocshArgInt};
+static const iocshArg * const poolSizeArgs[1] = {&poolSizeArg0};
+static const iocshFuncDef poolSizeDef = {"motorDrvComPoolSize", 1, poolSizeArgs};
+
+static void poolSizeCallFunc(const iocshArgBuf *args)
+{
+    motorDrvComPoolSize(args[0].ival);
+}
+
+static const iocshArg cardThreadsArg0 = {"Enable", iocshArgInt};
+static const iocshArg * const cardThreadsArgs[1] = {&cardThreadsArg0};
+static const iocshFuncDef cardThreadsDef = {"motorDrvComCardThreads", 1, cardThreadsArgs};
+
+static void cardThreadsCallFunc(const iocshArgBuf *args)
+{
+    motorDrvComCardThreads(args[0].ival);
+}
+
+static const iocshArg timingArg0 = {"Enable", iocshArgInt};
+static const iocshArg * const timingArgs[1] = {&timingArg0};
+static const iocshFuncDef timingDef = {"motorDrvComTiming", 1, timingArgs};
+
+static void timingCallFunc(const iocshArgBuf *args)
+{
+    motorDrvComTiming(args[0].ival);
+}
+
+static const iocshArg reportArg0 = {"Report level", iocshArgInt};
+static const iocshArg * const reportArgs[1] = {&reportArg0};
+static const iocshFuncDef reportDef = {"motorDrvComReport", 1, reportArgs};
+
+static void reportCallFunc(const iocshArgBuf *args)
+{
+    motorDrvComReport(args[0].ival);
+}
+
+static void motordrvComRegister(void)
+{
+    iocshRegister(&poolSizeDef, poolSizeCallFunc);
+    iocshRegister(&cardThreadsDef, cardThreadsCallFunc);
+    iocshRegister(&timingDef, timingCallFunc);
+    iocshRegister(&reportDef, reportCallFunc);
+}
+
+epicsExportRegistrar(motordrvComRegister);
+
+} // extern "C"
@@ -90,7 +90,9 @@ enum msg_types {
 };
 
 
-/* Macros used to set/clear bits in any_motor_in_motion variable. */
+/* Deprecated: *any_inmotion_ptr is now the number of cards in motion, kept
+   by motordrvCom; it is no longer a bitmask and drivers must not set it.
+   These only work for cards 0 to 31 and will be removed. */
 #define SET_MM_ON(v,a)  v|=(1<<a)
 #define SET_MM_OFF(v,a) v&=~(1<<a)
 
@@ -118,6 +120,11 @@ struct mess_node
     char *postmsgptr;
     char const *termstring;	/* Termination string for STOP_AXIS command
 				    (see process_messages()). */
+    epicsTimeStamp info_due;	/* When a parked INFO request is processed
+				   (see process_message()); zero until it is
+				   first parked. */
+    epicsUInt64 send_time;	/* Monotonic time of motor_send() in ns, 0
+				   unless motorDrvComTiming is enabled. */
 };
 
 /* initial position query to driver - device and driver support only */
@@ -142,10 +149,14 @@ struct axis_status
     char home;
 };
 
+struct motordrvComPvt;
+
 struct circ_queue	/* Circular queue structure. */
 {
-    struct mess_node *head;
-    struct mess_node *tail;
+    struct mess_node *head;	/* For the message queue (queptr), the nodes
+				   being taken by motor_task(), oldest first. */
+    struct mess_node *tail;	/* For the message queue, the nodes pushed by
+				   motor_send() since, newest first. */
 };
 
 /*----------------motor state info-----------------*/
@@ -190,13 +201,15 @@ struct driver_table
     int (*get_card_info) (int, MOTOR_CARD_QUERY *, struct driver_table *);
     int (*get_axis_info) (int, int, MOTOR_AXIS_QUERY *, struct driver_table *);
     struct circ_queue *queptr;
-    epicsEvent *quelockptr;
-    struct circ_queue *freeptr;
-    epicsEvent *freelockptr;
+    epicsEvent *quelockptr;		/* No longer used; the message queue is lock-free. */
+    struct circ_queue *freeptr;		/* No longer used; see comPvt. */
+    epicsEvent *freelockptr;		/* No longer used; see comPvt. */
     epicsEvent *semptr;
     struct controller ***card_array;
     int *cardcnt_ptr;
-    int *any_inmotion_ptr;
+    int *any_inmotion_ptr;		/* Number of cards with motors in motion,
+					   set by motordrvCom.  This was a bitmask
+					   of the cards in motion (SET_MM_ON). */
     RTN_STATUS (*sendmsg) (int, const char *, const char *);
     int (*getmsg) (int, char *, int);
     int (*setstat) (int, int);
@@ -204,12 +217,32 @@ struct driver_table
     void (*strtstat) (int);			/* Optional; start status function or NULL. */
     const bool *const init_indicator;		/* Driver initialized indicator. */
     const char **axis_names;				/* Axis name array or NULL. */
+    /* Optional; appends a command (card, message, axis name) to the NUL
+       terminated line in a buffer of the given size, so that several
+       commands for one card are sent by one sendmsg() call with a NULL
+       axis name.  Returns 0, or -1 if the command does not fit.  NULL
+       sends each command on its own.  For cards with cmnd_response,
+       getmsg(card, buffer, 1) is called once for each command in the line
+       after it is sent, so the card must answer each of them as it would
+       answer the command sent on its own. */
+    int (*coalesce) (int, char *, int, const char *, const char *);
+    int coalesce_len;			/* Maximum length of a coalesced line. */
+    /* Non-zero if the driver supports a worker thread per card (see
+       motorDrvComCardThreads).  The worker of each card then calls sendmsg(),
+       getmsg(), setstat(), query_done(), coalesce() and strtstat(card) for
+       that card, at the same time as the workers of the other cards call
+       them for theirs; any state the driver shares between cards must be
+       protected.  strtstat() is called with a card number, not ALL_CARDS. */
+    int card_threads;
+    struct motordrvComPvt *comPvt;	/* Private to motordrvCom (mess_node pool,
+					   cards in motion); leave out of driver
+					   initializers. */
 };
 
 
 struct thread_args
 {
-    int motor_scan_rate; /* Poll rate in HZ. */
+    int motor_scan_rate; /* Poll rate in HZ; see also motor_card_scan_rate(). */
     struct driver_table *table;
     double update_delay; /* Some controllers (OMS VME58) require a delay
     between a move command and a status update to prevent "stale" data.  A
@@ -224,5 +257,10 @@ epicsShareFunc int motor_free(struct mess_node *, struct driver_table *);
 epicsShareFunc int motor_card_info(int, MOTOR_CARD_QUERY *, struct driver_table *);
 epicsShareFunc int motor_axis_info(int, int, MOTOR_AXIS_QUERY *, struct driver_table *);
 epicsShareFunc int motor_task(struct thread_args *);
+epicsShareFunc int motor_card_scan_rate(int, double, struct driver_table *);
+epicsShareFunc int motorDrvComPoolSize(int);
+epicsShareFunc int motorDrvComCardThreads(int);
+epicsShareFunc int motorDrvComTiming(int);
+epicsShareFunc void motorDrvComReport(int);
 
 #endif	/* INCmotordrvComh */
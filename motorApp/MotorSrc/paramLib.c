@@ -12,29 +12,45 @@ drvMotorSim.c code.
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <epicsTypes.h>
 #define epicsExportSharedSymbols
 #include <shareLib.h>
 #include "paramLib.h"
 
 typedef enum { paramUndef, paramDouble, paramInt } paramType;
 
-typedef struct
+/* The changed flags are kept as a bitset, one bit per parameter */
+#define FLAG_BITS 32
+#define FLAG_WORDS(nvals) (((nvals) + FLAG_BITS - 1) / FLAG_BITS)
+#define SET_FLAG(params, index) \
+    ((params)->flags[(index) / FLAG_BITS] |= ((epicsUInt32) 1 << ((index) % FLAG_BITS)))
+
+#if defined(__GNUC__)
+#define lowestSetBit(word) __builtin_ctz(word)
+#else
+static int lowestSetBit( epicsUInt32 word )
 {
-    paramType type;
-    union
+    int bit = 0;
+
+    while (!(word & 1))
     {
-        double dval;
-        int    ival;
-    } data;
-} paramVal;
+        word >>= 1;
+        bit++;
+    }
+    return bit;
+}
+#endif
 
 typedef struct paramList
 {
     paramIndex startVal;
     paramIndex nvals;
-    int * flags;
-    paramIndex * set_flags;
-    paramVal * vals;
+    epicsUInt32 * flags;             /* Bitset of changed parameters */
+    paramIndex * set_flags;          /* List of changed parameters passed to the callback */
+    unsigned char * types;           /* paramType of each parameter */
+    double * dvals;                  /* Values of the double parameters */
+    int * ivals;                     /* Values of the integer parameters */
+    unsigned long * changeCounts;    /* Number of times each parameter has changed */
     int forceCallback;
     paramCallback callback;
     void * param;
@@ -54,7 +70,10 @@ static void paramDestroy( PARAMS params )
 {
     if (params->flags != NULL) free( params->flags );
     if (params->set_flags != NULL) free( params->set_flags );
-    if (params->vals != NULL) free( params->vals );
+    if (params->types != NULL) free( params->types );
+    if (params->dvals != NULL) free( params->dvals );
+    if (params->ivals != NULL) free( params->ivals );
+    if (params->changeCounts != NULL) free( params->changeCounts );
     free( params );
     params = NULL;
 }
@@ -76,9 +95,12 @@ static PARAMS paramCreate( paramIndex startVal, paramIndex nvals )
 
     if ( nvals > 0 &&
          (params != NULL) &&
-         ((params->flags = (int *) calloc( nvals, sizeof(int))) != NULL ) &&
+         ((params->flags = (epicsUInt32 *) calloc( FLAG_WORDS(nvals), sizeof(epicsUInt32))) != NULL ) &&
          ((params->set_flags = (paramIndex *) calloc( nvals, sizeof(paramIndex))) != NULL ) &&
-         ((params->vals = (paramVal *) calloc( nvals, sizeof(paramVal)) ) != NULL ) )
+         ((params->types = (unsigned char *) calloc( nvals, sizeof(unsigned char))) != NULL ) &&
+         ((params->dvals = (double *) calloc( nvals, sizeof(double))) != NULL ) &&
+         ((params->ivals = (int *) calloc( nvals, sizeof(int))) != NULL ) &&
+         ((params->changeCounts = (unsigned long *) calloc( nvals, sizeof(unsigned long))) != NULL ) )
     {
         params->startVal = startVal;
         params->nvals = nvals;
@@ -109,12 +131,13 @@ static int paramSetInteger( PARAMS params, paramIndex index, int value )
     index -= params->startVal;
     if (index >= 0 && index < params->nvals)
     {
-        if ( params->vals[index].type != paramInt ||
-             params->vals[index].data.ival != value )
+        if ( params->types[index] != paramInt ||
+             params->ivals[index] != value )
         {
-            params->flags[index] = 1;
-            params->vals[index].type = paramInt;
-            params->vals[index].data.ival = value;
+            SET_FLAG( params, index );
+            params->changeCounts[index]++;
+            params->types[index] = paramInt;
+            params->ivals[index] = value;
         }
         status = PARAM_OK;
     }
@@ -138,12 +161,13 @@ static int paramSetDouble( PARAMS params, paramIndex index, double value )
     index -= params->startVal;
     if (index >=0 && index < params->nvals)
     {
-        if ( params->vals[index].type != paramDouble ||
-             params->vals[index].data.dval != value )
+        if ( params->types[index] != paramDouble ||
+             params->dvals[index] != value )
         {
-            params->flags[index] = 1;
-            params->vals[index].type = paramDouble;
-            params->vals[index].data.dval = value;
+            SET_FLAG( params, index );
+            params->changeCounts[index]++;
+            params->types[index] = paramDouble;
+            params->dvals[index] = value;
         }
         status = PARAM_OK;
     }
@@ -167,10 +191,10 @@ static int paramGetInteger( PARAMS params, paramIndex index, int * value )
     index -= params->startVal;
     if (index >= 0 && index < params->nvals)
     {
-        switch (params->vals[index].type)
+        switch (params->types[index])
         {
-        case paramDouble: *value = (int) floor(params->vals[index].data.dval+0.5); break;
-        case paramInt: *value = params->vals[index].data.ival; break;
+        case paramDouble: *value = (int) floor(params->dvals[index]+0.5); break;
+        case paramInt: *value = params->ivals[index]; break;
         default: status = 0;
         }
     }
@@ -196,10 +220,10 @@ static int paramGetDouble( PARAMS params, paramIndex index, double * value )
     index -= params->startVal;
     if (index >= 0 && index < params->nvals)
     {
-        switch (params->vals[index].type)
+        switch (params->types[index])
         {
-        case paramDouble: *value = params->vals[index].data.dval; break;
-        case paramInt: *value = (double) params->vals[index].data.ival; break;
+        case paramDouble: *value = params->dvals[index]; break;
+        case paramInt: *value = (double) params->ivals[index]; break;
         default: status = 0;
         }
     }
@@ -234,7 +258,7 @@ static int paramSetCallback( PARAMS params, paramCallback callback, void * param
     {
         int i;
         for (i = 0; i < params->nvals; i++)
-            if (params->vals[i].type != paramUndef) params->flags[i] = 1;
+            if (params->types[i] != paramUndef) SET_FLAG( params, i );
     }
 
     return PARAM_OK;
@@ -253,16 +277,20 @@ static void paramCallCallback( PARAMS params )
 {
     unsigned int i;
     int nFlags=0;
+    epicsUInt32 word;
 
-    for (i = 0; i < params->nvals; i++)
+    /* Only the words of the bitset with changed parameters need to be looked at */
+    for (i = 0; i < FLAG_WORDS(params->nvals); i++)
     {
-        if (params->flags[i])
+        word = params->flags[i];
+        if (word == 0) continue;
+        params->flags[i] = 0;
+        while (word)
         {
-            params->set_flags[nFlags] = i + params->startVal;
+            params->set_flags[nFlags] = i * FLAG_BITS + lowestSetBit( word ) + params->startVal;
             nFlags++;
-            params->flags[i] = 0;
+            word &= word - 1;
         }
-
     }
     if ( (params->forceCallback || nFlags > 0) && params->callback != NULL )
     {
@@ -287,6 +315,38 @@ static void paramForceCallback( PARAMS params )
     params->forceCallback=1;
 }
 
+/** Sets a number of parameters and calls the callback routine once.
+
+    This is equivalent to calling paramSetInteger or paramSetDouble for each of the settings
+    followed by paramCallCallback, so the callback is passed all the parameters that changed.
+
+    \param params    [in]   Pointer to PARAM handle returned by paramCreate.
+    \param nsettings [in]   Number of settings.
+    \param settings  [in]   Array of parameter indices and values.
+
+    \return Integer indicating 0 (PARAM_OK) for success or non-zero if any index was out of range.
+                            The settings with valid indices are made in either case.
+*/
+static int paramSetBatch( PARAMS params, unsigned int nsettings, const paramSetting * settings )
+{
+    int status = PARAM_OK;
+    unsigned int i;
+
+    for (i = 0; i < nsettings; i++)
+    {
+        if (settings[i].isDouble)
+        {
+            if (paramSetDouble( params, settings[i].index, settings[i].dval ) != PARAM_OK) status = PARAM_ERROR;
+        }
+        else
+        {
+            if (paramSetInteger( params, settings[i].index, settings[i].ival ) != PARAM_OK) status = PARAM_ERROR;
+        }
+    }
+    paramCallCallback( params );
+    return status;
+}
+
 /** Prints the current values in the parameter system to stdout
 
     This routine prints all the values in the parameter system to stdout. 
@@ -303,13 +363,15 @@ static void paramDump( PARAMS params )
     printf( "Number of parameters is: %d\n", params->nvals );
     for (i =0; i < params->nvals; i++)
     {
-        switch (params->vals[i].type)
+        switch (params->types[i])
         {
         case paramDouble:
-            printf( "Parameter %d is a double, value %f\n", i+ params->startVal, params->vals[i].data.dval );
+            printf( "Parameter %d is a double, value %f, changed %lu times\n",
+                    i+ params->startVal, params->dvals[i], params->changeCounts[i] );
             break;
         case paramInt:
-            printf( "Parameter %d is an integer, value %d\n", i+ params->startVal, params->vals[i].data.ival );
+            printf( "Parameter %d is an integer, value %d, changed %lu times\n",
+                    i+ params->startVal, params->ivals[i], params->changeCounts[i] );
             break;
         default:
             printf( "Parameter %d is undefined\n", i+ params->startVal );
@@ -329,7 +391,8 @@ static paramSupport motorParamSupport =
   paramGetDouble,
   paramSetCallback,
   paramDump,
-  paramForceCallback
+  paramForceCallback,
+  paramSetBatch
 };
 
 paramSupport * motorParam = &motorParamSupport;
@@ -14,6 +14,15 @@ typedef unsigned int paramIndex;
 typedef struct paramList * PARAMS;
 typedef void (*paramCallback)( void *, unsigned int, unsigned int * ); 
 
+/** One value for setBatch */
+typedef struct
+{
+  paramIndex index;    /**< Index number of the parameter */
+  int isDouble;        /**< Non-zero to set the parameter to dval, zero to set it to ival */
+  int ival;
+  double dval;
+} paramSetting;
+
 typedef struct
 {
   PARAMS (*create)    ( paramIndex startVal, paramIndex nvals );
@@ -26,6 +35,7 @@ typedef struct
   int  (*setCallback) ( PARAMS params, paramCallback callback, void * param );
   void (*dump)        ( PARAMS params );
   void (*forceCallback)( PARAMS params );
+  int  (*setBatch)    ( PARAMS params, unsigned int nsettings, const paramSetting * settings );
 } paramSupport;
 
 epicsShareExtern paramSupport * motorParam;
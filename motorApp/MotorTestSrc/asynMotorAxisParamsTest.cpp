@@ -0,0 +1,197 @@
+/* asynMotorAxisParamsTest.cpp
+ *
+ * Tests the motion parameters that each asynMotorAxis caches for the move and
+ * poll paths, on a simulated controller with 64 axes.  The moves must use the
+ * values last written to the parameters.  The cost of a move and of a poll
+ * cycle is reported, together with the cost of the parameter library lookups
+ * that the cache replaced.
+ */
+#include <stdio.h>
+
+#include <epicsTime.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include <asynPortDriver.h>
+#include "asynMotorController.h"
+#include "asynMotorAxis.h"
+
+#define NUM_AXES      64
+#define MOVE_ROUNDS   100   /* Moves of each axis. */
+#define POLL_CYCLES   1000
+
+static const char *portName = "motorParamsTest";
+
+class TestController;
+
+/** Axis that records the parameters of the last move and is never moving. */
+class TestAxis : public asynMotorAxis {
+public:
+  TestAxis(TestController *pC, int axisNo);
+  asynStatus move(double position, int relative, double minVelocity, double maxVelocity, double acceleration);
+  asynStatus poll(bool *moving);
+
+  double minVelocity_;
+  double maxVelocity_;
+  double acceleration_;
+};
+
+/** Controller with NUM_AXES TestAxis objects and no poller thread. */
+class TestController : public asynMotorController {
+public:
+  TestController();
+  void moveLookups(int axisNo);
+  void pollLookups(int axisNo);
+  int moveAbsReason() { return motorMoveAbs_; }
+  int velBaseReason() { return motorVelBase_; }
+  int velocityReason() { return motorVelocity_; }
+  int accelReason() { return motorAccel_; }
+};
+
+TestAxis::TestAxis(TestController *pC, int axisNo)
+  : asynMotorAxis(pC, axisNo), minVelocity_(0.), maxVelocity_(0.), acceleration_(0.)
+{
+}
+
+asynStatus TestAxis::move(double position, int relative, double minVelocity, double maxVelocity, double acceleration)
+{
+  minVelocity_ = minVelocity;
+  maxVelocity_ = maxVelocity;
+  acceleration_ = acceleration;
+  return asynSuccess;
+}
+
+asynStatus TestAxis::poll(bool *moving)
+{
+  *moving = false;
+  return asynSuccess;
+}
+
+TestController::TestController()
+  : asynMotorController(portName, NUM_AXES, 0, 0, 0, ASYN_CANBLOCK | ASYN_MULTIDEVICE, 1, 0, 0)
+{
+  int axis;
+
+  for (axis=0; axis<NUM_AXES; axis++) new TestAxis(this, axis);
+}
+
+/** The parameter library lookups that writeFloat64() and startMove() did on each move before the cache. */
+void TestController::moveLookups(int axisNo)
+{
+  int autoPower;
+  double value;
+
+  getIntegerParam(axisNo, motorPowerAutoOnOff_, &autoPower);
+  getDoubleParam(axisNo, motorPowerOnDelay_, &value);
+  getDoubleParam(axisNo, motorVelBase_, &value);
+  getDoubleParam(axisNo, motorVelocity_, &value);
+  getDoubleParam(axisNo, motorAccel_, &value);
+}
+
+/** The parameter library lookups that pollCycle() did for each axis before the cache. */
+void TestController::pollLookups(int axisNo)
+{
+  int autoPower;
+  double value;
+
+  getIntegerParam(axisNo, motorPowerAutoOnOff_, &autoPower);
+  getDoubleParam(axisNo, motorPowerOffDelay_, &value);
+}
+
+static TestController *pC;
+static asynUser *pasynUsers[NUM_AXES];
+
+static void writeAxis(int axis, int reason, double value)
+{
+  pasynUsers[axis]->reason = reason;
+  pC->lock();
+  pC->writeFloat64(pasynUsers[axis], value);
+  pC->unlock();
+}
+
+/* Writes the motion parameters of each axis, moves it and checks what the axis received. */
+static void testMoveParams(double scale)
+{
+  TestAxis *pAxis;
+  int axis, wrong = 0;
+
+  for (axis=0; axis<NUM_AXES; axis++) {
+    writeAxis(axis, pC->velBaseReason(), scale * axis);
+    writeAxis(axis, pC->velocityReason(), scale * (axis + 100));
+    writeAxis(axis, pC->accelReason(), scale * (axis + 200));
+    writeAxis(axis, pC->moveAbsReason(), 1.);
+    pAxis = static_cast<TestAxis *>(pC->getAxis(axis));
+    if ((pAxis->minVelocity_ != scale * axis) ||
+        (pAxis->maxVelocity_ != scale * (axis + 100)) ||
+        (pAxis->acceleration_ != scale * (axis + 200))) wrong++;
+  }
+  testOk(wrong == 0, "moves use the parameters last written, scale %g: %d of %d axes wrong",
+         scale, wrong, NUM_AXES);
+}
+
+static double secondsSince(const epicsTimeStamp *start)
+{
+  epicsTimeStamp now;
+
+  epicsTimeGetCurrent(&now);
+  return epicsTimeDiffInSeconds(&now, start);
+}
+
+static void benchmark()
+{
+  epicsTimeStamp start;
+  double moveTime, moveLookupTime, pollTime, pollLookupTime;
+  int i, axis;
+
+  epicsTimeGetCurrent(&start);
+  for (i=0; i<MOVE_ROUNDS; i++) {
+    for (axis=0; axis<NUM_AXES; axis++) writeAxis(axis, pC->moveAbsReason(), i);
+  }
+  moveTime = secondsSince(&start) / (MOVE_ROUNDS * NUM_AXES);
+
+  pC->lock();
+  epicsTimeGetCurrent(&start);
+  for (i=0; i<MOVE_ROUNDS; i++) {
+    for (axis=0; axis<NUM_AXES; axis++) pC->moveLookups(axis);
+  }
+  moveLookupTime = secondsSince(&start) / (MOVE_ROUNDS * NUM_AXES);
+  pC->unlock();
+
+  epicsTimeGetCurrent(&start);
+  for (i=0; i<POLL_CYCLES; i++) pC->pollCycle(false);
+  pollTime = secondsSince(&start) / POLL_CYCLES;
+
+  pC->lock();
+  epicsTimeGetCurrent(&start);
+  for (i=0; i<POLL_CYCLES; i++) {
+    for (axis=0; axis<NUM_AXES; axis++) pC->pollLookups(axis);
+  }
+  pollLookupTime = secondsSince(&start) / POLL_CYCLES;
+  pC->unlock();
+
+  testDiag("move: %.3f us, %.3f us before the cache (parameter lookups %.3f us)",
+           1e6 * moveTime, 1e6 * (moveTime + moveLookupTime), 1e6 * moveLookupTime);
+  testDiag("poll cycle of %d axes: %.3f us, %.3f us before the cache (parameter lookups %.3f us)",
+           NUM_AXES, 1e6 * pollTime, 1e6 * (pollTime + pollLookupTime), 1e6 * pollLookupTime);
+}
+
+MAIN(asynMotorAxisParamsTest)
+{
+  int axis;
+
+  testPlan(3);
+
+  pC = new TestController();
+  for (axis=0; axis<NUM_AXES; axis++) {
+    pasynUsers[axis] = pasynManager->createAsynUser(0, 0);
+    pasynManager->connectDevice(pasynUsers[axis], portName, axis);
+  }
+
+  testMoveParams(1.);
+  testMoveParams(2.);
+  testOk(pC->pollCycle(false) >= 0., "poll cycle of %d axes", NUM_AXES);
+
+  benchmark();
+
+  return testDone();
+}
@@ -0,0 +1,24 @@
+/* motorTestHarness.c
+ *
+ * Runs all the motor library tests on targets without a shell.
+ */
+
+#include <epicsUnitTest.h>
+#include <epicsExit.h>
+
+int motordrvComQueueTest(void);
+#ifdef HAVE_ASYN
+int asynMotorAxisParamsTest(void);
+#endif
+
+void motorTestHarness(void)
+{
+    testHarness();
+
+    runTest(motordrvComQueueTest);
+#ifdef HAVE_ASYN
+    runTest(asynMotorAxisParamsTest);
+#endif
+
+    epicsExit(0);
+}
@@ -0,0 +1,228 @@
+/* motordrvComQueueTest.cc
+ *
+ * Tests the model 1 message queue of motordrvCom with a synthetic driver
+ * table.  Producer threads call motor_send() while motor_task() takes the
+ * messages off the queue and hands them to the driver's sendmsg().  The
+ * messages of each producer must arrive in the order they were sent, and the
+ * enqueue time and the time from motor_send() to sendmsg() are reported for
+ * 1, 8 and 64 producers.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsStdio.h>
+#include <epicsMutex.h>
+#include <epicsTime.h>
+#include <epicsAtomic.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+
+#include "motor.h"
+#include "motordrvCom.h"
+
+#define MAX_PRODUCERS   64
+#define NUM_MESSAGES    1000    /* Sent by each producer. */
+
+/* --- The synthetic driver: one card with one axis. --- */
+static struct controller card0;
+static struct controller *cards[1] = {&card0};
+static struct controller **motor_state = cards;
+static int total_cards = 1;
+static int any_motor_in_motion;
+static struct circ_queue mess_queue;
+static epicsEvent motor_sem(epicsEventEmpty);
+static bool initialized = true;
+
+/* What sendmsg() has received; only accessed by motor_task() while a run is going. */
+static int lastSeq[MAX_PRODUCERS];
+static int received;
+static int expected;
+static int outOfOrder;
+static double latencySum;
+static double latencyMax;
+static epicsEvent *receivedAll;
+
+static RTN_STATUS send_mess(int card, const char *message, const char *axis_name)
+{
+    int producer, seq;
+    epicsTimeStamp sent, now;
+    double latency;
+
+    if (sscanf(message, "P%d S%d T%u.%u", &producer, &seq,
+               &sent.secPastEpoch, &sent.nsec) != 4 ||
+        producer < 0 || producer >= MAX_PRODUCERS)
+    {
+        testDiag("unexpected message \"%s\"", message);
+        outOfOrder++;
+        return (ERROR);
+    }
+    epicsTimeGetCurrent(&now);
+    latency = epicsTimeDiffInSeconds(&now, &sent);
+    latencySum += latency;
+    if (latency > latencyMax)
+        latencyMax = latency;
+
+    if (seq != lastSeq[producer] + 1)
+        outOfOrder++;
+    lastSeq[producer] = seq;
+    if (++received == expected)
+        receivedAll->signal();
+    return (OK);
+}
+
+static int recv_mess(int card, char *buffer, int amount)
+{
+    buffer[0] = '\0';
+    return (0);
+}
+
+static int set_status(int card, int signal)
+{
+    return (0);
+}
+
+static struct driver_table drv_table =
+{
+    NULL,
+    motor_send,
+    motor_free,
+    motor_card_info,
+    motor_axis_info,
+    &mess_queue,
+    NULL,
+    NULL,
+    NULL,
+    &motor_sem,
+    &motor_state,
+    &total_cards,
+    &any_motor_in_motion,
+    send_mess,
+    recv_mess,
+    set_status,
+    NULL,
+    NULL,
+    &initialized,
+    NULL
+};
+
+static struct thread_args targs = {10, &drv_table, 0.0};
+
+/* --- The producers. --- */
+struct producer
+{
+    int id;
+    int nsent;
+    epicsMutexId go;            /* Held by runProducers() until all producers are created. */
+    epicsEvent *done;
+    int *running;
+    double enqueueSum;
+    double enqueueMax;
+};
+
+static void producerTask(void *arg)
+{
+    struct producer *pprod = (struct producer *) arg;
+    struct mess_node node;
+    epicsTimeStamp start, end;
+    double time;
+    int seq;
+
+    memset(&node, 0, sizeof(node));
+    node.type = IMMEDIATE;
+    node.card = 0;
+    node.signal = 0;
+
+    epicsMutexMustLock(pprod->go);
+    epicsMutexUnlock(pprod->go);
+    for (seq = 1; seq <= NUM_MESSAGES; seq++)
+    {
+        epicsTimeGetCurrent(&start);
+        sprintf(node.message, "P%d S%d T%u.%u", pprod->id, seq, start.secPastEpoch, start.nsec);
+        if (drv_table.send(&node, &drv_table) == OK)
+            pprod->nsent++;
+        epicsTimeGetCurrent(&end);
+        time = epicsTimeDiffInSeconds(&end, &start);
+        pprod->enqueueSum += time;
+        if (time > pprod->enqueueMax)
+            pprod->enqueueMax = time;
+    }
+    if (epicsAtomicDecrIntT(pprod->running) == 0)
+        pprod->done->signal();
+}
+
+static void runProducers(int nproducers)
+{
+    static struct producer producers[MAX_PRODUCERS];
+    epicsMutexId go = epicsMutexMustCreate();
+    epicsEvent done(epicsEventEmpty), all(epicsEventEmpty);
+    int running = nproducers;
+    int nsent = 0;
+    double enqueueSum = 0.0, enqueueMax = 0.0;
+    char name[16];
+    int itera;
+
+    memset(lastSeq, 0, sizeof(lastSeq));
+    received = 0;
+    outOfOrder = 0;
+    latencySum = 0.0;
+    latencyMax = 0.0;
+    expected = nproducers * NUM_MESSAGES;
+    receivedAll = &all;
+
+    epicsMutexMustLock(go);
+    for (itera = 0; itera < nproducers; itera++)
+    {
+        struct producer *pprod = &producers[itera];
+
+        memset(pprod, 0, sizeof(*pprod));
+        pprod->id = itera;
+        pprod->go = go;
+        pprod->done = &done;
+        pprod->running = &running;
+        epicsSnprintf(name, sizeof(name), "producer%d", itera);
+        epicsThreadMustCreate(name, epicsThreadPriorityMedium,
+                              epicsThreadGetStackSize(epicsThreadStackSmall),
+                              producerTask, pprod);
+    }
+    epicsMutexUnlock(go);
+
+    testOk(done.wait(60.0), "%d producers finished sending", nproducers);
+    testOk(all.wait(60.0), "%d producers: all messages received", nproducers);
+
+    for (itera = 0; itera < nproducers; itera++)
+    {
+        nsent += producers[itera].nsent;
+        enqueueSum += producers[itera].enqueueSum;
+        if (producers[itera].enqueueMax > enqueueMax)
+            enqueueMax = producers[itera].enqueueMax;
+    }
+    testOk(nsent == expected, "%d producers: %d of %d messages sent", nproducers, nsent, expected);
+    testOk(received == expected && outOfOrder == 0,
+           "%d producers: %d messages received, %d out of order", nproducers, received, outOfOrder);
+    testDiag("%2d producers: motor_send() mean %.2f us, max %.2f us; "
+             "motor_send() to sendmsg() mean %.2f us, max %.2f us",
+             nproducers, 1e6 * enqueueSum / nsent, 1e6 * enqueueMax,
+             received ? 1e6 * latencySum / received : 0.0, 1e6 * latencyMax);
+    epicsMutexDestroy(go);
+}
+
+MAIN(motordrvComQueueTest)
+{
+    testPlan(12);
+
+    card0.total_axis = 1;
+    card0.cmnd_response = false;
+
+    epicsThreadMustCreate("motorQueueTest", epicsThreadPriorityHigh,
+                          epicsThreadGetStackSize(epicsThreadStackMedium),
+                          (EPICSTHREADFUNC) motor_task, (void *) &targs);
+
+    runProducers(1);
+    runProducers(8);
+    runProducers(64);
+
+    return testDone();
+}